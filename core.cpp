@@ -12,7 +12,7 @@ typedef uint64_t ADDR64;          // Update address size to 64-bit
 typedef pair<ADDR64, ADDR64> AddrRange;
 
 // Implementation of Parameter operators
-bool Parameter::operator==(const Parameter& other) {
+bool Parameter::operator==(const Parameter& other) const {
     if (ty == other.ty) {
         switch (ty) {
         case IMM:
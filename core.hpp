@@ -31,6 +31,8 @@ enum Register {
 };
 enum class OperandType {IMM, REG, MEM, UNK} ;
 
+struct OpDesc;   // opcode descriptor, see semantics.hpp
+
 // An operand as parsed from assembly
 struct Operand {
     //enum OperandType { IMM, REG, MEM,UNK };
@@ -51,7 +53,7 @@ struct Parameter {
     Register reg;   // Which register if type == REG
     ADDR64 idx;     // If MEM, this could be the address. If IMM, the immediate value
 
-    bool operator==(const Parameter &other);
+    bool operator==(const Parameter &other) const;
     bool operator<(const Parameter &other) const;
     bool isIMM();
     void show() const;
@@ -67,10 +69,13 @@ struct Inst {
     string opcstr;         // Opcode (string)
     vector<string> oprs;   // Raw operands (string)
     int oprnum;            // Number of operands
+    const OpDesc *desc = nullptr;  // Semantics row for opcstr/oprnum
     Operand *oprd[4];      // Parsed operand structures
     ADDR64 ctxreg[8];      // Context registers (64-bit)
     ADDR64 raddr;          // Memory read address
     ADDR64 waddr;          // Memory write address
+    uint64_t off = UINT64_MAX;  // Byte offset of the line in the trace file
+    uint32_t len = 0;           // Line length including the newline
 
     // Parameter-based representation of source/dest
     vector<Parameter> src;    // Primary sources
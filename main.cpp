@@ -47,5 +47,8 @@ int main(int argc, char **argv) {
     // Dump the formula (now for "rax" instead of "eax")
     se1->dumpreg("rax");
 
+    // Releases every formula node the engine built
+    delete se1;
+
     return 0;
 }
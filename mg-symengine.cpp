@@ -4,6 +4,8 @@
 #include <vector>
 #include <set>
 #include <map>
+#include <deque>
+#include <unordered_map>
 #include <queue>
 #include <bitset>
 #include <sstream>
@@ -44,29 +46,41 @@ enum OperTy
 };
 typedef pair<int, int> BitRange;
 
-// A symbolic or concrete value in a formula
+// Parts of a HYBRID value, keyed by bit range
+struct HybridParts
+{
+    map<BitRange, Value *> childs;
+};
+
+// Elements and lane mask of a vector value
+struct VectorParts
+{
+    vector<Value *> elems;
+    bitset<16> maskBits;
+};
+
+// A symbolic or concrete value in a formula. Which fields are meaningful
+// depends on the kind: an operation node has opr; a concrete leaf has
+// bsconval and conval; a HYBRID value has hyb; a vector value (SYMBOL,
+// len 512) has vec. Values live in their engine's NodeArena.
 struct Value
 {
     int id; // a unique id for each value
     ValueTy valty;
-    Operation *opr;
-    string conval;       // concrete value (string form)
-    bitset<64> bsconval; // 64-bit concrete value stored as bitset
-    vector<Value *> vectorVal;
-    bitset<16> maskBits;
-    BitRange brange;               // range of bits in the 64-bit
-    map<BitRange, Value *> childs; // child values in a hybrid value
     int len;                       // length of the value in bits (up to 64)
+    BitRange brange;               // range of bits in the 64-bit
+    Operation *opr;
+    bitset<64> bsconval;           // 64-bit concrete value stored as bitset
+    const char *conval;            // concrete value (string form)
+    union {
+        HybridParts *hyb;
+        VectorParts *vec;
+    };
 
     static int idseed;
-    Value(ValueTy vty);
     Value(ValueTy vty, int l);
-    Value(ValueTy vty, string con);
-    Value(ValueTy vty, string con, int l);
-    Value(ValueTy vty, bitset<64> bs);
     Value(ValueTy vty, Operation *oper);
-    Value(ValueTy vty, Operation *oper, int l);
-    Value(ValueTy vty, int l, int numElements);
+    Value(bitset<64> bs, const char *con);
 
     void setElement(int idx, Value *v);
     Value *getElement(int idx);
@@ -75,88 +89,40 @@ struct Value
     bool isSymbol();
     bool isConcrete();
     bool isHybrid();
+    bool isVector();
 };
 
 int Value::idseed = 0;
 
-Value::Value(ValueTy vty) : opr(NULL)
+Value::Value(ValueTy vty, int l)
+    : valty(vty), len(l), opr(NULL), conval(""), hyb(NULL)
 {
     id = ++idseed;
-    valty = vty;
-    len = 64;
-}
-
-Value::Value(ValueTy vty, int l) : opr(NULL)
-{
-    id = ++idseed;
-    valty = vty;
-    len = l;
-}
-
-Value::Value(ValueTy vty, string con) : opr(NULL)
-{
-    id = ++idseed;
-    valty = vty;
-    // Convert the string hex to a 64-bit integer, store in bsconval
-    uint64_t tmp = 0;
-    if (!con.empty())
-    {
-        // handle possible “0x” prefix
-        tmp = stoull(con, 0, 16);
-    }
-    bsconval = bitset<64>(tmp);
-
-    conval = con;
-    brange.first = 0;
-    brange.second = 63;
-    len = 64;
-}
-
-Value::Value(ValueTy vty, string con, int l) : opr(NULL)
-{
-    id = ++idseed;
-    valty = vty;
-    conval = con;
-    len = l;
-}
-
-Value::Value(ValueTy vty, bitset<64> bs) : opr(NULL)
-{
-    id = ++idseed;
-    valty = vty;
-    bsconval = bs;
-    len = 64;
 }
 
 Value::Value(ValueTy vty, Operation *oper)
+    : valty(vty), len(64), opr(oper), conval(""), hyb(NULL)
 {
     id = ++idseed;
-    valty = vty;
-    opr = oper;
-    len = 64;
 }
 
-Value::Value(ValueTy vty, Operation *oper, int l)
+Value::Value(bitset<64> bs, const char *con)
+    : valty(CONCRETE), len(64), brange(0, 63), opr(NULL), bsconval(bs), conval(con), hyb(NULL)
 {
     id = ++idseed;
-    valty = vty;
-    opr = oper;
-    len = l;
 }
 
-Value::Value(ValueTy vty, int l, int numElements)
-    : opr(NULL), len(l)
+// hyb and vec share storage: only a vector value may touch vec
+bool Value::isVector()
 {
-    id = ++idseed;
-    valty = vty;
-    vectorVal.resize(numElements, nullptr);
+    return (this->valty == SYMBOL && this->len == 512 && this->vec);
 }
 
-void Value::setElement(int idx, Value *v) { vectorVal[idx] = v; }
-Value *Value::getElement(int idx) { return vectorVal[idx]; }
+void Value::setElement(int idx, Value *v) { if (isVector()) vec->elems[idx] = v; }
+Value *Value::getElement(int idx) { return isVector() ? vec->elems[idx] : NULL; }
 
-void Value::setMaskBit(int idx, bool bit) { maskBits[idx] = bit; }
-bool Value::getMaskBit(int idx) { return maskBits[idx]; }
+void Value::setMaskBit(int idx, bool bit) { if (isVector()) vec->maskBits[idx] = bit; }
+bool Value::getMaskBit(int idx) { return isVector() ? (bool)vec->maskBits[idx] : false; }
 
 bool Value::isSymbol()
 {
@@ -187,27 +153,9 @@ struct Operation
     string opty;
     Value *val[3];
 
-    Operation(string opt, Value *v1);
-    Operation(string opt, Value *v1, Value *v2);
     Operation(string opt, Value *v1, Value *v2, Value *v3);
 };
 
-Operation::Operation(string opt, Value *v1)
-{
-    opty = opt;
-    val[0] = v1;
-    val[1] = NULL;
-    val[2] = NULL;
-}
-
-Operation::Operation(string opt, Value *v1, Value *v2)
-{
-    opty = opt;
-    val[0] = v1;
-    val[1] = v2;
-    val[2] = NULL;
-}
-
 Operation::Operation(string opt, Value *v1, Value *v2, Value *v3)
 {
     opty = opt;
@@ -216,196 +164,184 @@ Operation::Operation(string opt, Value *v1, Value *v2, Value *v3)
     val[2] = v3;
 }
 
-Value *buildop1(string opty, Value *v1)
+// Structural key of an operation node: operator, child IDs, width
+struct OpKey
 {
-    Operation *oper = new Operation(opty, v1);
-    Value *result;
-
-    if (v1->isSymbol())
-        result = new Value(SYMBOL, oper);
-    else
-        result = new Value(CONCRETE, oper);
+    string opty;
+    int child[3];
+    int len;
 
-    return result;
-}
+    bool operator==(const OpKey &o) const
+    {
+        return opty == o.opty && child[0] == o.child[0] && child[1] == o.child[1]
+            && child[2] == o.child[2] && len == o.len;
+    }
+};
 
-Value *buildop2(string opty, Value *v1, Value *v2)
+struct OpKeyHash
 {
-    Operation *oper = new Operation(opty, v1, v2);
-    Value *result;
-
-    if (v1->isSymbol() || v2->isSymbol())
-        result = new Value(SYMBOL, oper);
-    else
-        result = new Value(CONCRETE, oper);
-
-    return result;
-}
+    size_t operator()(const OpKey &k) const
+    {
+        size_t h = hash<string>()(k.opty);
+        for (int i = 0; i < 3; ++i)
+            h = h * 0x9e3779b97f4a7c15ULL + (size_t)k.child[i];
+        return h * 0x9e3779b97f4a7c15ULL + (size_t)k.len;
+    }
+};
 
-// Currently there is no 3-operand operation in this code,
-// it is reserved for future expansion.
-Value *buildop3(string opty, Value *v1, Value *v2, Value *v3)
+// Objects of one type, placement-constructed in fixed-size blocks and
+// all destroyed together with the pool
+template <typename T>
+class NodePool
 {
-    Operation *oper = new Operation(opty, v1, v2, v3);
-    Value *result;
-
-    if (v1->isSymbol() || v2->isSymbol() || v3->isSymbol())
-        result = new Value(SYMBOL, oper);
-    else
-        result = new Value(CONCRETE, oper);
+    static const size_t BLOCK = 1024;
+    vector<T *> blocks;
+    size_t used = BLOCK;
 
-    return result;
-}
-
-//**********************************************************
-//   Symbolic Execution Engine (64-bit version)
-//**********************************************************
-
-// Example 64-bit address range
-struct AddrRange
-{
-    ADDR64 first;
-    ADDR64 second;
+public:
+    NodePool() {}
+    NodePool(const NodePool &) = delete;
+    NodePool &operator=(const NodePool &) = delete;
 
-    AddrRange() : first(0), second(0) {}
-    AddrRange(ADDR64 f, ADDR64 s) : first(f), second(s) {}
+    template <typename... Args>
+    T *make(Args &&...args)
+    {
+        if (used == BLOCK)
+        {
+            blocks.push_back(static_cast<T *>(::operator new(BLOCK * sizeof(T))));
+            used = 0;
+        }
+        return new (blocks.back() + used++) T(std::forward<Args>(args)...);
+    }
 
-    // comparison for map key
-    bool operator<(const AddrRange &o) const
+    ~NodePool()
     {
-        if (first < o.first)
-            return true;
-        if (first == o.first)
-            return (second < o.second);
-        return false;
+        for (size_t b = 0; b < blocks.size(); ++b)
+        {
+            size_t n = (b + 1 < blocks.size()) ? BLOCK : used;
+            for (size_t i = 0; i < n; ++i)
+                blocks[b][i].~T();
+            ::operator delete(blocks[b]);
+        }
     }
 };
 
-// struct Operand
-// {
-//     // This is just a placeholder; the real definition depends on your code
-//     // Keep or adjust fields as needed
-//     int tag;
-//     int ty;
-//     int bit; // how many bits in the operand
-//     vector<string> field;
-//     // ...
-// };
-
-// struct Inst
-// {
-//     // Another placeholder
-//     int id;
-//     string opcstr;
-//     int oprnum;
-//     Operand *oprd[3];
-//     ADDR64 addrn;
-//     // For 64-bit registers, we might store them in ctxreg[0..7] for rax..rbp
-//     uint64_t ctxreg[8];
-
-//     // read addresses, write addresses
-//     ADDR64 raddr;
-//     ADDR64 waddr;
-//     // ...
-// };
-
-// We also have a FullMap type used in outputBitCVC
-typedef map<int, int> FullMapPair;
-typedef pair<FullMapPair, FullMapPair> FullMap;
-
-class SEEngine
+/*
+ * All nodes built by one engine, released in bulk when it is destroyed.
+ * Operation nodes are hash-consed: unique per (operator, child IDs,
+ * width), and concrete leaves per constant string, so identical subterms
+ * share one Value and two formulas are equal exactly when their pointers
+ * are. Shared Values must not be modified after construction.
+ */
+struct NodeArena
 {
-private:
-    map<string, Value *> ctx; // 64-bit register context
-    list<Inst>::iterator start;
-    list<Inst>::iterator end;
-    list<Inst>::iterator ip;
+    NodePool<Value> values;
+    NodePool<Operation> opers;
+    NodePool<HybridParts> hybrids;
+    NodePool<VectorParts> vectors;
+    deque<string> text;     // conval strings of split constants
+    unordered_map<OpKey, Value *, OpKeyHash> uniquetab;
+    unordered_map<string, Value *> consttab;
+};
 
-    map<AddrRange, Value *> mem;      // memory model
-    map<Value *, AddrRange> meminput; // inputs from memory
-    map<Value *, string> reginput;    // inputs from registers
+SEEngine::SEEngine() : nodes(new NodeArena)
+{
+    ctx = {
+        {"rax", nullptr},
+        {"rbx", nullptr},
+        {"rcx", nullptr},
+        {"rdx", nullptr},
+        {"rsi", nullptr},
+        {"rdi", nullptr},
+        {"rsp", nullptr},
+        {"rbp", nullptr}
+    };
+}
 
-    bool memfind(AddrRange ar)
-    {
-        auto ii = mem.find(ar);
-        return (ii != mem.end());
-    }
+SEEngine::~SEEngine()
+{
+    delete nodes;
+}
 
-    bool memfind(ADDR64 b, ADDR64 e)
-    {
-        AddrRange ar(b, e);
-        auto ii = mem.find(ar);
-        return (ii != mem.end());
-    }
+static Value *mkvalue(NodeArena *a, ValueTy vty, int len)
+{
+    return a->values.make(vty, len);
+}
 
-    bool isnew(AddrRange ar);
-    bool issubset(AddrRange ar, AddrRange *superset);
-    bool issuperset(AddrRange ar, AddrRange *subset);
+static Value *mkvector(NodeArena *a, int len, int n)
+{
+    Value *v = a->values.make(SYMBOL, len);
+    v->vec = a->vectors.make();
+    v->vec->elems.resize(n, nullptr);
+    return v;
+}
 
-    Value *readReg(string &s);
-    void writeReg(string &s, Value *v);
+Value *SEEngine::mkconst(const string &con)
+{
+    auto it = nodes->consttab.find(con);
+    if (it != nodes->consttab.end())
+        return it->second;
+    // handle possible "0x" prefix
+    bitset<64> bs(con.empty() ? 0 : stoull(con, 0, 16));
+    it = nodes->consttab.emplace(con, nullptr).first;
+    it->second = nodes->values.make(bs, it->first.c_str());
+    return it->second;
+}
 
-    Value *readMem(ADDR64 addr, int nbyte);
-    void writeMem(ADDR64 addr, int nbyte, Value *v);
+Value *SEEngine::hashcons(const string &opty, Value *v1, Value *v2, Value *v3)
+{
+    OpKey k{opty, {v1->id, v2 ? v2->id : 0, v3 ? v3->id : 0}, v1->len};
+    auto it = nodes->uniquetab.find(k);
+    if (it != nodes->uniquetab.end())
+        return it->second;
+
+    Operation *oper = nodes->opers.make(opty, v1, v2, v3);
+    bool sym = v1->isSymbol() || (v2 && v2->isSymbol()) || (v3 && v3->isSymbol());
+    Value *result = nodes->values.make(sym ? SYMBOL : CONCRETE, oper);
+    nodes->uniquetab.emplace(k, result);
+    return result;
+}
 
-    ADDR64 getRegConVal(string reg);
-    ADDR64 calcAddr(Operand *opr);
-    void printformula(Value *v);
+Value *SEEngine::buildop1(string opty, Value *v1)
+{
+    return hashcons(opty, v1, NULL, NULL);
+}
 
-public:
-    // Initialize register context to null
-    SEEngine()
-    {
-        ctx = {
-            {"rax", nullptr},
-            {"rbx", nullptr},
-            {"rcx", nullptr},
-            {"rdx", nullptr},
-            {"rsi", nullptr},
-            {"rdi", nullptr},
-            {"rsp", nullptr},
-            {"rbp", nullptr}};
-    }
-
-    void init(Value *v1, Value *v2, Value *v3, Value *v4,
-              Value *v5, Value *v6, Value *v7, Value *v8,
-              list<Inst>::iterator it1,
-              list<Inst>::iterator it2);
-
-    void init(list<Inst>::iterator it1,
-              list<Inst>::iterator it2);
-
-    void initAllRegSymol(list<Inst>::iterator it1,
-                         list<Inst>::iterator it2);
-
-    int symexec();
-    ADDR64 conexec(Value *f, map<Value *, ADDR64> *input);
-    void outputFormula(string reg);
-    void dumpreg(string reg);
-    void printAllRegFormulas();
-    void printAllMemFormulas();
-    void printInputSymbols(string output);
-    Value *getValue(string s) { return ctx[s]; }
-    vector<Value *> getAllOutput();
-    void showMemInput();
-    void printMemFormula(ADDR64 addr1, ADDR64 addr2);
-};
+Value *SEEngine::buildop2(string opty, Value *v1, Value *v2)
+{
+    return hashcons(opty, v1, v2, NULL);
+}
+
+// Currently there is no 3-operand operation in this code,
+// it is reserved for future expansion.
+Value *SEEngine::buildop3(string opty, Value *v1, Value *v2, Value *v3)
+{
+    return hashcons(opty, v1, v2, v3);
+}
+
+//**********************************************************
+//   Symbolic Execution Engine (64-bit version)
+//**********************************************************
 
 //----------------------------------------------
 //  Implementation details of SEEngine (64-bit)
 //----------------------------------------------
 bool hasVal(Value *v, int start, int end)
 {
+    if (!v->isHybrid())
+        return false;
     BitRange br(start, end);
-    auto i = v->childs.find(br);
-    return (i != v->childs.end());
+    auto i = v->hyb->childs.find(br);
+    return (i != v->hyb->childs.end());
 }
 
 Value *readVal(Value *v, int start, int end)
 {
+    if (!v->isHybrid())
+        return NULL;
     BitRange br(start, end);
-    auto i = v->childs.find(br);
-    if (i == v->childs.end())
+    auto i = v->hyb->childs.find(br);
+    if (i == v->hyb->childs.end())
         return NULL;
     else
         return i->second;
@@ -429,14 +365,22 @@ string bs2str(bitset<64> bs, BitRange br)
     return strs.str();
 }
 
-Value *writeVal(Value *from, Value *to, int start, int end)
+// Bits [first, last] of the concrete value whole, as a new leaf
+static Value *mkconstpart(NodeArena *a, Value *whole, int first, int last)
+{
+    a->text.push_back(bs2str(whole->bsconval, BitRange(first, last)));
+    Value *v = a->values.make(whole->bsconval, a->text.back().c_str());
+    v->brange = BitRange(first, last);
+    return v;
+}
+
+Value *SEEngine::writeVal(Value *from, Value *to, int start, int end)
 {
-    Value *res = new Value(HYBRID);
     BitRange brfrom(start, end);
     if (to->isHybrid())
     {
-        auto i = to->childs.find(brfrom);
-        if (i != to->childs.end())
+        auto i = to->hyb->childs.find(brfrom);
+        if (i != to->hyb->childs.end())
         {
             i->second = from;
             return to;
@@ -449,22 +393,14 @@ Value *writeVal(Value *from, Value *to, int start, int end)
     }
     else if (from->isSymbol() && to->isConcrete())
     {
-        int s1 = to->brange.first;
-        int e1 = to->brange.second;
-        Value *v1 = new Value(CONCRETE, to->bsconval);
-        Value *v2 = new Value(CONCRETE, to->bsconval);
-
-        v1->brange.first = s1;
-        v1->brange.second = start - 1;
-        v1->conval = bs2str(v1->bsconval, v1->brange);
+        Value *res = mkvalue(nodes, HYBRID, 64);
+        res->hyb = nodes->hybrids.make();
+        Value *v1 = mkconstpart(nodes, to, to->brange.first, start - 1);
+        Value *v2 = mkconstpart(nodes, to, end + 1, to->brange.second);
 
-        v2->brange.first = end + 1;
-        v2->brange.second = e1;
-        v2->conval = bs2str(v2->bsconval, v2->brange);
-
-        res->childs.insert(pair<BitRange, Value *>(v1->brange, v1));
-        res->childs.insert(pair<BitRange, Value *>(brfrom, from));
-        res->childs.insert(pair<BitRange, Value *>(v2->brange, v2));
+        res->hyb->childs.insert(pair<BitRange, Value *>(v1->brange, v1));
+        res->hyb->childs.insert(pair<BitRange, Value *>(brfrom, from));
+        res->hyb->childs.insert(pair<BitRange, Value *>(v2->brange, v2));
 
         return res;
     }
@@ -599,7 +535,7 @@ Value *SEEngine::readReg(string &s)
         {
             // build a mask of 0x00000000ffffffff
             Value *v0 = ctx[rname];
-            Value *v1 = new Value(CONCRETE, "0x00000000ffffffff");
+            Value *v1 = mkconst("0x00000000ffffffff");
             res = buildop2("and", v0, v1);
             return res;
         }
@@ -618,7 +554,7 @@ Value *SEEngine::readReg(string &s)
         else
         {
             Value *v0 = ctx[rname];
-            Value *v1 = new Value(CONCRETE, "0x000000000000ffff");
+            Value *v1 = mkconst("0x000000000000ffff");
             res = buildop2("and", v0, v1);
             return res;
         }
@@ -659,7 +595,7 @@ Value *SEEngine::readReg(string &s)
         else
         {
             Value *v0 = ctx[rname];
-            Value *v1 = new Value(CONCRETE, "0x00000000000000ff");
+            Value *v1 = mkconst("0x00000000000000ff");
             res = buildop2("and", v0, v1);
             return res;
         }
@@ -686,10 +622,10 @@ Value *SEEngine::readReg(string &s)
         else
         {
             Value *v0 = ctx[rname];
-            Value *v1 = new Value(CONCRETE, "0x000000000000ff00");
+            Value *v1 = mkconst("0x000000000000ff00");
             Value *v2 = buildop2("and", v0, v1);
             // shift right by 8 bits
-            Value *v3 = new Value(CONCRETE, "0x8");
+            Value *v3 = mkconst("0x8");
             res = buildop2("shr", v2, v3);
             return res;
         }
@@ -719,7 +655,7 @@ void SEEngine::writeReg(string &s, Value *v)
         // e.g. "eax" => combine the old "rax" top bits with new lower 32 bits
         string rname = "r" + s.substr(1); // "eax" => "rax"
         // mask out the low 32 bits
-        Value *v0 = new Value(CONCRETE, "0xffffffff00000000");
+        Value *v0 = mkconst("0xffffffff00000000");
         Value *v1 = ctx[rname];
         Value *v2 = buildop2("and", v1, v0);
         // or in the new value
@@ -733,7 +669,7 @@ void SEEngine::writeReg(string &s, Value *v)
         // e.g. "ax" => "rax"
         string rname = "r" + s;
         // mask out the low 16 bits
-        Value *v0 = new Value(CONCRETE, "0xffffffffffff0000");
+        Value *v0 = mkconst("0xffffffffffff0000");
         Value *v1 = ctx[rname];
         Value *v2 = buildop2("and", v1, v0);
         res = buildop2("or", v2, v);
@@ -762,7 +698,7 @@ void SEEngine::writeReg(string &s, Value *v)
             rname = "rsp";
 
         // mask out low 8 bits
-        Value *v0 = new Value(CONCRETE, "0xffffffffffffff00");
+        Value *v0 = mkconst("0xffffffffffffff00");
         Value *v1 = ctx[rname];
         Value *v2 = buildop2("and", v1, v0);
         res = buildop2("or", v2, v);
@@ -789,10 +725,10 @@ void SEEngine::writeReg(string &s, Value *v)
         else
         {
             // shift the new value left by 8
-            Value *v0 = new Value(CONCRETE, "0x8");
+            Value *v0 = mkconst("0x8");
             Value *v1 = buildop2("shl", v, v0);
             // mask out bits [8..15]
-            Value *v2 = new Value(CONCRETE, "0xffffffffffff00ff");
+            Value *v2 = mkconst("0xffffffffffff00ff");
             Value *v3 = ctx[rname];
             Value *v4 = buildop2("and", v3, v2);
             res = buildop2("or", v4, v1);
@@ -868,7 +804,7 @@ Value *SEEngine::readMem(ADDR64 addr, int nbyte)
     // If range is brand new, create a new symbolic Value
     if (isnew(ar))
     {
-        Value *v = new Value(SYMBOL, nbyte * 8); // nbyte*8 bits
+        Value *v = mkvalue(nodes, SYMBOL, nbyte * 8); // nbyte*8 bits
         mem[ar] = v;
         meminput[v] = ar;
         return v;
@@ -901,9 +837,9 @@ Value *SEEngine::readMem(ADDR64 addr, int nbyte)
         strs << "0x" << hex << shift_bits;
 
         Value *v0 = mem[res];
-        Value *v1 = new Value(CONCRETE, mask.str());
+        Value *v1 = mkconst(mask.str());
         Value *v2 = buildop2("and", v0, v1);
-        Value *v3 = new Value(CONCRETE, strs.str());
+        Value *v3 = mkconst(strs.str());
         Value *v4 = buildop2("shr", v2, v3); // shift right
         return v4;
     }
@@ -957,9 +893,9 @@ void SEEngine::writeMem(ADDR64 addr, int nbyte, Value *v)
         strs << "0x" << hex << shift_bits;
 
         Value *v0 = mem[res];
-        Value *v1 = new Value(CONCRETE, mask.str());
+        Value *v1 = mkconst(mask.str());
         Value *v2 = buildop2("and", v0, v1);
-        Value *v3 = new Value(CONCRETE, strs.str());
+        Value *v3 = mkconst(strs.str());
         Value *v4 = buildop2("shl", v, v3);
         Value *v5 = buildop2("or", v2, v4);
         mem[res] = v5;
@@ -1010,14 +946,14 @@ void SEEngine::init(list<Inst>::iterator it1,
 void SEEngine::initAllRegSymol(list<Inst>::iterator it1,
                                list<Inst>::iterator it2)
 {
-    Value *v1 = new Value(SYMBOL, 64);
-    Value *v2 = new Value(SYMBOL, 64);
-    Value *v3 = new Value(SYMBOL, 64);
-    Value *v4 = new Value(SYMBOL, 64);
-    Value *v5 = new Value(SYMBOL, 64);
-    Value *v6 = new Value(SYMBOL, 64);
-    Value *v7 = new Value(SYMBOL, 64);
-    Value *v8 = new Value(SYMBOL, 64);
+    Value *v1 = mkvalue(nodes, SYMBOL, 64);
+    Value *v2 = mkvalue(nodes, SYMBOL, 64);
+    Value *v3 = mkvalue(nodes, SYMBOL, 64);
+    Value *v4 = mkvalue(nodes, SYMBOL, 64);
+    Value *v5 = mkvalue(nodes, SYMBOL, 64);
+    Value *v6 = mkvalue(nodes, SYMBOL, 64);
+    Value *v7 = mkvalue(nodes, SYMBOL, 64);
+    Value *v8 = mkvalue(nodes, SYMBOL, 64);
 
     ctx["rax"] = v1;
     ctx["rbx"] = v2;
@@ -1041,12 +977,21 @@ void SEEngine::initAllRegSymol(list<Inst>::iterator it1,
     end = it2;
 }
 
-// no-effect instructions
-set<string> noeffectinst = {
-    "test", "jmp", "jz", "jbe", "jo", "jno", "js", "jns", "je", "jne",
-    "jnz", "jb", "jnae", "jc", "jnb", "jae", "jnc", "jna", "ja", "jnbe",
-    "jl", "jnge", "jge", "jnl", "jle", "jng", "jg", "jnle", "jp", "jpe",
-    "jnp", "jpo", "jcxz", "jecxz", "ret", "cmp", "call"};
+// Per-form execution of the instruction at ip, indexed by SemForm
+const SEEngine::ExecRule SEEngine::execRules[(int)SemForm::COUNT] = {
+    &SEEngine::execNoEffect,    // NOEFFECT
+    &SEEngine::execPush,        // PUSH
+    &SEEngine::execPop,         // POP
+    &SEEngine::execMov,         // MOV
+    &SEEngine::execLea,         // LEA
+    &SEEngine::execXchg,        // XCHG
+    &SEEngine::execUnary,       // UNARY
+    &SEEngine::execBinary,      // BINARY
+    &SEEngine::execTernary,     // TERNARY
+    &SEEngine::execVBinary,     // VBINARY
+    &SEEngine::execVLoad,       // VLOAD
+    &SEEngine::execUnknown,     // UNKNOWN
+};
 
 // The main symbolic execution loop
 int SEEngine::symexec()
@@ -1054,351 +999,414 @@ int SEEngine::symexec()
     for (list<Inst>::iterator it = start; it != end; ++it)
     {
         ip = it;
+        if ((this->*execRules[(int)opDesc(*it)->form])() != 0)
+            return 1;
+    }
+    return 0;
+}
+
+int SEEngine::execNoEffect()
+{
+    return 0;
+}
 
-        // skip no-effect instructions
-        if (noeffectinst.find(it->opcstr) != noeffectinst.end())
-            continue;
+int SEEngine::execPush()
+{
+    Operand *op0 = ip->oprd[0];
+    Value *v0, *temp;
+    int nbyte;
 
-        switch (it->oprnum)
+    if (op0->ty == OperandType::IMM)
+    {
+        v0 = mkconst(op0->field[0]);
+        writeMem(ip->waddr, 8, v0); // 64-bit push => 8 bytes
+    }
+    else if (op0->ty == OperandType::REG)
+    {
+        nbyte = op0->bit / 8;
+        temp = readReg(op0->field[0]);
+        writeMem(ip->waddr, nbyte, temp);
+    }
+    else if (op0->ty == OperandType::MEM)
+    {
+        nbyte = op0->bit / 8;
+        v0 = readMem(ip->raddr, nbyte);
+        writeMem(ip->waddr, nbyte, v0);
+    }
+    else
+    {
+        cout << "push error: operand not Imm/Reg/Mem!" << endl;
+        return 1;
+    }
+    return 0;
+}
+
+int SEEngine::execPop()
+{
+    Operand *op0 = ip->oprd[0];
+    Value *temp;
+    int nbyte;
+
+    if (op0->ty == OperandType::REG)
+    {
+        nbyte = op0->bit / 8;
+        temp = readMem(ip->raddr, nbyte);
+        writeReg(op0->field[0], temp);
+    }
+    else if (op0->ty == OperandType::MEM)
+    {
+        nbyte = op0->bit / 8;
+        temp = readMem(ip->raddr, nbyte);
+        writeMem(ip->waddr, nbyte, temp);
+    }
+    else
+    {
+        cout << "pop error: operand not Reg/Mem!" << endl;
+        return 1;
+    }
+    return 0;
+}
+
+// mov, movzx, movsx, ...
+int SEEngine::execMov()
+{
+    Operand *op0 = ip->oprd[0];
+    Operand *op1 = ip->oprd[1];
+    Value *v1, *temp;
+    int nbyte;
+
+    if (op0->ty == OperandType::REG)
+    {
+        if (op1->ty == OperandType::IMM)
         {
-        case 0:
-            // no operands
-            break;
-        case 1:
+            v1 = mkconst(op1->field[0]);
+            writeReg(op0->field[0], v1);
+        }
+        else if (op1->ty == OperandType::REG)
         {
-            Operand *op0 = it->oprd[0];
-            Value *v0, *res, *temp;
-            int nbyte;
-            if (it->opcstr == "push")
-            {
-                if (op0->ty == OperandType::IMM)
-                {
-                    v0 = new Value(CONCRETE, op0->field[0]);
-                    writeMem(it->waddr, 8, v0); // 64-bit push => 8 bytes
-                }
-                else if (op0->ty == OperandType::REG)
-                {
-                    nbyte = op0->bit / 8;
-                    temp = readReg(op0->field[0]);
-                    writeMem(it->waddr, nbyte, temp);
-                }
-                else if (op0->ty == OperandType::MEM)
-                {
-                    nbyte = op0->bit / 8;
-                    v0 = readMem(it->raddr, nbyte);
-                    writeMem(it->waddr, nbyte, v0);
-                }
-                else
-                {
-                    cout << "push error: operand not Imm/Reg/Mem!" << endl;
-                    return 1;
-                }
-            }
-            else if (it->opcstr == "pop")
-            {
-                if (op0->ty == OperandType::REG)
-                {
-                    nbyte = op0->bit / 8;
-                    temp = readMem(it->raddr, nbyte);
-                    writeReg(op0->field[0], temp);
-                }
-                else if (op0->ty == OperandType::MEM)
-                {
-                    nbyte = op0->bit / 8;
-                    temp = readMem(it->raddr, nbyte);
-                    writeMem(it->waddr, nbyte, temp);
-                }
-                else
-                {
-                    cout << "pop error: operand not Reg/Mem!" << endl;
-                    return 1;
-                }
-            }
-            else
-            {
-                // 1-operand instructions, e.g. "neg", "inc", etc.
-                if (op0->ty == OperandType::REG)
-                {
-                    v0 = readReg(op0->field[0]);
-                    res = buildop1(it->opcstr, v0);
-                    writeReg(op0->field[0], res);
-                }
-                else if (op0->ty == OperandType::MEM)
-                {
-                    nbyte = op0->bit / 8;
-                    v0 = readMem(it->raddr, nbyte);
-                    res = buildop1(it->opcstr, v0);
-                    writeMem(it->waddr, nbyte, res);
-                }
-                else
-                {
-                    cout << "[Error] " << it->id << ": Unknown 1-op instruction!\n";
-                    return 1;
-                }
-            }
-            break;
+            temp = readReg(op1->field[0]);
+            writeReg(op0->field[0], temp);
         }
-        case 2:
+        else if (op1->ty == OperandType::MEM)
         {
-            Operand *op0 = it->oprd[0];
-            Operand *op1 = it->oprd[1];
-            Value *v0, *v1, *res, *temp;
-            int nbyte;
+            nbyte = op1->bit / 8;
+            v1 = readMem(ip->raddr, nbyte);
+            writeReg(op0->field[0], v1);
+        }
+        else
+        {
+            cerr << "op1 not Imm/Reg/Mem\n";
+            return 1;
+        }
+    }
+    else if (op0->ty == OperandType::MEM)
+    {
+        if (op1->ty == OperandType::IMM)
+        {
+            temp = mkconst(op1->field[0]);
+            nbyte = op0->bit / 8;
+            writeMem(ip->waddr, nbyte, temp);
+        }
+        else if (op1->ty == OperandType::REG)
+        {
+            temp = readReg(op1->field[0]);
+            nbyte = op0->bit / 8;
+            writeMem(ip->waddr, nbyte, temp);
+        }
+        else
+        {
+            cerr << "Error: The first operand in MOV is Mem, second not Imm/Reg?\n";
+        }
+    }
+    else
+    {
+        cerr << "Error: The first operand in MOV is not Reg or Mem!\n";
+    }
+    return 0;
+}
 
-            if (it->opcstr == "mov")
-            {
-                // mov
-                if (op0->ty == OperandType::REG)
-                {
-                    if (op1->ty == OperandType::IMM)
-                    {
-                        v1 = new Value(CONCRETE, op1->field[0]);
-                        writeReg(op0->field[0], v1);
-                    }
-                    else if (op1->ty == OperandType::REG)
-                    {
-                        temp = readReg(op1->field[0]);
-                        writeReg(op0->field[0], temp);
-                    }
-                    else if (op1->ty == OperandType::MEM)
-                    {
-                        nbyte = op1->bit / 8;
-                        v1 = readMem(it->raddr, nbyte);
-                        writeReg(op0->field[0], v1);
-                    }
-                    else
-                    {
-                        cerr << "op1 not Imm/Reg/Mem\n";
-                        return 1;
-                    }
-                }
-                else if (op0->ty == OperandType::MEM)
-                {
-                    if (op1->ty == OperandType::IMM)
-                    {
-                        temp = new Value(CONCRETE, op1->field[0]);
-                        nbyte = op0->bit / 8;
-                        writeMem(it->waddr, nbyte, temp);
-                    }
-                    else if (op1->ty == OperandType::REG)
-                    {
-                        temp = readReg(op1->field[0]);
-                        nbyte = op0->bit / 8;
-                        writeMem(it->waddr, nbyte, temp);
-                    }
-                    else
-                    {
-                        cerr << "Error: The first operand in MOV is Mem, second not Imm/Reg?\n";
-                    }
-                }
-                else
-                {
-                    cerr << "Error: The first operand in MOV is not Reg or Mem!\n";
-                }
-            }
-            else if (it->opcstr == "lea")
-            {
-                // lea
-                if (op0->ty != OperandType::REG || op1->ty != OperandType::MEM)
-                {
-                    cerr << "lea format error!\n";
-                }
-                switch (op1->tag)
-                {
-                case 5:
-                {
-                    // e.g. lea reg, [r1 + r2*n]
-                    Value *f0, *f1, *f2;
-                    f0 = readReg(op1->field[0]);
-                    f1 = readReg(op1->field[1]);
-                    f2 = new Value(CONCRETE, op1->field[2]);
-                    res = buildop2("imul", f1, f2);
-                    res = buildop2("add", f0, res);
-                    writeReg(op0->field[0], res);
-                    break;
-                }
-                default:
-                    cerr << "Other tags in addr not ready for lea!\n";
-                    break;
-                }
-            }
-            else if (it->opcstr == "xchg")
-            {
-                // xchg
-                if (op1->ty == OperandType::REG)
-                {
-                    v1 = readReg(op1->field[0]);
-                    if (op0->ty == OperandType::REG)
-                    {
-                        v0 = readReg(op0->field[0]);
-                        writeReg(op1->field[0], v0);
-                        writeReg(op0->field[0], v1);
-                    }
-                    else if (op0->ty == OperandType::MEM)
-                    {
-                        nbyte = op0->bit / 8;
-                        v0 = readMem(it->raddr, nbyte);
-                        writeReg(op1->field[0], v0);
-                        writeMem(it->waddr, nbyte, v1);
-                    }
-                    else
-                    {
-                        cerr << "xchg error: 1\n";
-                    }
-                }
-                else if (op1->ty == OperandType::MEM)
-                {
-                    nbyte = op1->bit / 8;
-                    v1 = readMem(it->raddr, nbyte);
-                    if (op0->ty == OperandType::REG)
-                    {
-                        v0 = readReg(op0->field[0]);
-                        writeReg(op0->field[0], v1);
-                        writeMem(it->waddr, nbyte, v0);
-                    }
-                    else
-                    {
-                        cerr << "xchg error: 3\n";
-                    }
-                }
-                else
-                {
-                    cerr << "xchg error: 2\n";
-                }
-            }
-            else
-            {
-                // handle 2-operand instructions: shl, shr, add, sub, xor, and, or, etc.
-                // read operand 1
-                if (op1->ty == OperandType::IMM)
-                {
-                    v1 = new Value(CONCRETE, op1->field[0]);
-                }
-                else if (op1->ty == OperandType::REG)
-                {
-                    v1 = readReg(op1->field[0]);
-                }
-                else if (op1->ty == OperandType::MEM)
-                {
-                    nbyte = op1->bit / 8;
-                    v1 = readMem(it->raddr, nbyte);
-                }
-                else
-                {
-                    cerr << "other instructions: op1 not Imm/Reg/Mem!\n";
-                    return 1;
-                }
+// lea reg, [base + index*scale +/- disp], any subset of the terms
+int SEEngine::execLea()
+{
+    Operand *op0 = ip->oprd[0];
+    Operand *op1 = ip->oprd[1];
 
-                // read operand 0
-                if (op0->ty == OperandType::REG)
-                {
-                    v0 = readReg(op0->field[0]);
-                    res = buildop2(it->opcstr, v0, v1);
-                    writeReg(op0->field[0], res);
-                }
-                else if (op0->ty == OperandType::MEM)
-                {
-                    nbyte = op0->bit / 8;
-                    v0 = readMem(it->raddr, nbyte);
-                    res = buildop2(it->opcstr, v0, v1);
-                    writeMem(it->waddr, nbyte, res);
-                }
-                else
-                {
-                    cerr << "other instructions: op0 not Reg/Mem!\n";
-                    return 1;
-                }
-            }
-            break;
+    if (op0->ty != OperandType::REG || op1->ty != OperandType::MEM)
+    {
+        cerr << "lea format error!\n";
+        return 0;
+    }
+
+    string *base = nullptr, *index = nullptr, *scale = nullptr;
+    string *sign = nullptr, *disp = nullptr;
+    string *f = op1->field;
+    switch (op1->tag)
+    {
+    case 7: base = &f[0]; index = &f[1]; scale = &f[2]; sign = &f[3]; disp = &f[4]; break;
+    case 6: index = &f[0]; scale = &f[1]; sign = &f[2]; disp = &f[3]; break;
+    case 5: base = &f[0]; index = &f[1]; scale = &f[2]; break;
+    case 4: base = &f[0]; sign = &f[1]; disp = &f[2]; break;
+    case 3: index = &f[0]; scale = &f[1]; break;
+    case 2: base = &f[0]; break;
+    case 1: disp = &f[0]; break;
+    default:
+        cerr << "Unrecognized addr tag for lea!\n";
+        return 0;
+    }
+    if (base && *base == "rip")
+    {
+        cerr << "rip-relative lea not ready!\n";
+        return 0;
+    }
+
+    Value *res = nullptr;
+    if (base)
+        res = readReg(*base);
+    if (index)
+    {
+        Value *term = buildop2("imul", readReg(*index), mkconst(*scale));
+        res = res ? buildop2("add", res, term) : term;
+    }
+    if (disp)
+    {
+        Value *c = mkconst(*disp);
+        if (!res)
+            res = c;
+        else
+            res = buildop2(*sign == "-" ? "sub" : "add", res, c);
+    }
+    writeReg(op0->field[0], res);
+    return 0;
+}
+
+int SEEngine::execXchg()
+{
+    Operand *op0 = ip->oprd[0];
+    Operand *op1 = ip->oprd[1];
+    Value *v0, *v1;
+    int nbyte;
+
+    if (op1->ty == OperandType::REG)
+    {
+        v1 = readReg(op1->field[0]);
+        if (op0->ty == OperandType::REG)
+        {
+            v0 = readReg(op0->field[0]);
+            writeReg(op1->field[0], v0);
+            writeReg(op0->field[0], v1);
+        }
+        else if (op0->ty == OperandType::MEM)
+        {
+            nbyte = op0->bit / 8;
+            v0 = readMem(ip->raddr, nbyte);
+            writeReg(op1->field[0], v0);
+            writeMem(ip->waddr, nbyte, v1);
+        }
+        else
+        {
+            cerr << "xchg error: 1\n";
+        }
+    }
+    else if (op1->ty == OperandType::MEM)
+    {
+        nbyte = op1->bit / 8;
+        v1 = readMem(ip->raddr, nbyte);
+        if (op0->ty == OperandType::REG)
+        {
+            v0 = readReg(op0->field[0]);
+            writeReg(op0->field[0], v1);
+            writeMem(ip->waddr, nbyte, v0);
         }
-        case 3:
+        else
         {
-            // three-operands instructions: e.g. "imul reg, reg, imm"
-            Operand *op0 = it->oprd[0];
-            Operand *op1 = it->oprd[1];
-            Operand *op2 = it->oprd[2];
-            Value *v1, *v2, *res;
+            cerr << "xchg error: 3\n";
+        }
+    }
+    else
+    {
+        cerr << "xchg error: 2\n";
+    }
+    return 0;
+}
 
-            if (it->opcstr == "imul" && op0->ty == OperandType::REG &&
-                op1->ty == OperandType::REG && op2->ty == OperandType::IMM)
-            {
-                v1 = readReg(op1->field[0]);
-                v2 = new Value(CONCRETE, op2->field[0]);
-                res = buildop2("imul", v1, v2);
-                writeReg(op0->field[0], res);
-            }
-            else
-            {
-                cerr << "3-operands instructions other than imul not handled!\n";
-            }
-            break;
-        }
-        case 4:
-        {
-            Operand *op0 = it->oprd[0]; // destination
-            Operand *op1 = it->oprd[1]; // first source
-            Operand *op2 = it->oprd[2]; // second source
-            Operand *op3 = it->oprd[3]; // immediate or memory operand
-
-            if (it->opcstr == "vpaddd") {
-                Operand *op0 = it->oprd[0];    // Destination
-                Operand *op1 = it->oprd[1];    // Source 1
-                Operand *op2 = it->oprd[2];    // Source 2
-                Operand *maskOp = it->oprd[3]; // Mask register (optional)
-
-                Value *dest = new Value(SYMBOL, 512, 16); // 512-bit vector with 16 elements
-                Value *src1 = readReg(op1->field[0]);
-                Value *src2 = readReg(op2->field[0]);
-
-                // Apply mask if present
-                if (maskOp) {
-                    Value *mask = readReg(maskOp->field[0]);
-                    for (int i = 0; i < 16; ++i) {
-                        if (mask->getMaskBit(i)) {
-                            Value *result = buildop2("add", src1->getElement(i), src2->getElement(i));
-                            dest->setElement(i, result);
-                        } else {
-                            dest->setElement(i, src1->getElement(i)); // Keep original value
-                        }
-                    }
-                } else {
-                    // No mask: perform addition on all elements
-                    for (int i = 0; i < 16; ++i) {
-                        Value *result = buildop2("add", src1->getElement(i), src2->getElement(i));
-                        dest->setElement(i, result);
-                    }
-                }
+// 1-operand instructions, e.g. "neg", "inc", etc.
+int SEEngine::execUnary()
+{
+    Operand *op0 = ip->oprd[0];
+    Value *v0, *res;
+    int nbyte;
 
-                writeReg(op0->field[0], dest);
-            } else if (it->opcstr == "vmovdqu32") {
-                Operand *op0 = it->oprd[0];    // Destination (register)
-                Operand *op1 = it->oprd[1];    // Source (memory)
-                Operand *maskOp = it->oprd[2]; // Mask register
-
-                Value *dest = new Value(SYMBOL, 512, 16); // 512-bit vector with 16 elements
-                Value *mask = readReg(maskOp->field[0]);  // Read mask register
-
-                for (int i = 0; i < 16; ++i) {
-                    if (mask->getMaskBit(i)) {
-                        Value *memVal = readMem(it->raddr + i * 4, 4); // Read 32-bit element
-                        dest->setElement(i, memVal);
-                    } else {
-                        dest->setElement(i, new Value(CONCRETE, "0x00000000")); // Zero if not masked
-                    }
-                }
+    if (op0->ty == OperandType::REG)
+    {
+        v0 = readReg(op0->field[0]);
+        res = buildop1(symOp(*ip), v0);
+        writeReg(op0->field[0], res);
+    }
+    else if (op0->ty == OperandType::MEM)
+    {
+        nbyte = op0->bit / 8;
+        v0 = readMem(ip->raddr, nbyte);
+        res = buildop1(symOp(*ip), v0);
+        writeMem(ip->waddr, nbyte, res);
+    }
+    else
+    {
+        cout << "[Error] " << ip->id << ": Unknown 1-op instruction!\n";
+        return 1;
+    }
+    return 0;
+}
+
+// 2-operand instructions: shl, shr, add, sub, xor, and, or, etc.
+int SEEngine::execBinary()
+{
+    Operand *op0 = ip->oprd[0];
+    Operand *op1 = ip->oprd[1];
+    Value *v0, *v1, *res;
+    int nbyte;
 
-                writeReg(op0->field[0], dest);
+    // read operand 1
+    if (op1->ty == OperandType::IMM)
+    {
+        v1 = mkconst(op1->field[0]);
+    }
+    else if (op1->ty == OperandType::REG)
+    {
+        v1 = readReg(op1->field[0]);
+    }
+    else if (op1->ty == OperandType::MEM)
+    {
+        nbyte = op1->bit / 8;
+        v1 = readMem(ip->raddr, nbyte);
+    }
+    else
+    {
+        cerr << "other instructions: op1 not Imm/Reg/Mem!\n";
+        return 1;
+    }
+
+    // read operand 0
+    if (op0->ty == OperandType::REG)
+    {
+        v0 = readReg(op0->field[0]);
+        res = buildop2(symOp(*ip), v0, v1);
+        writeReg(op0->field[0], res);
+    }
+    else if (op0->ty == OperandType::MEM)
+    {
+        nbyte = op0->bit / 8;
+        v0 = readMem(ip->raddr, nbyte);
+        res = buildop2(symOp(*ip), v0, v1);
+        writeMem(ip->waddr, nbyte, res);
+    }
+    else
+    {
+        cerr << "other instructions: op0 not Reg/Mem!\n";
+        return 1;
+    }
+    return 0;
+}
+
+// three-operands instructions: e.g. "imul reg, reg/mem, imm"
+int SEEngine::execTernary()
+{
+    Operand *op0 = ip->oprd[0];
+    Operand *op1 = ip->oprd[1];
+    Operand *op2 = ip->oprd[2];
+    Value *v1, *v2, *res;
+
+    if (op0->ty != OperandType::REG || op2->ty != OperandType::IMM)
+    {
+        cerr << "3-operands instructions other than imul reg, r/m, imm not handled!\n";
+        return 0;
+    }
+    if (op1->ty == OperandType::REG)
+        v1 = readReg(op1->field[0]);
+    else if (op1->ty == OperandType::MEM)
+        v1 = readMem(ip->raddr, op1->bit / 8);
+    else
+    {
+        cerr << "3-operands instructions: op1 not Reg/Mem!\n";
+        return 0;
+    }
+    v2 = mkconst(op2->field[0]);
+    res = buildop2(symOp(*ip), v1, v2);
+    writeReg(op0->field[0], res);
+    return 0;
+}
+
+// vpaddd dst, src1, src2 [, mask]: lane-wise operation on 16 dwords
+int SEEngine::execVBinary()
+{
+    if (ip->oprnum < 3)
+    {
+        cerr << "[Error] " << ip->opcstr << " needs 3 operands!\n";
+        return 0;
+    }
+    Operand *op0 = ip->oprd[0];    // Destination
+    Operand *op1 = ip->oprd[1];    // Source 1
+    Operand *op2 = ip->oprd[2];    // Source 2
+    Operand *maskOp = ip->oprnum > 3 ? ip->oprd[3] : nullptr; // Mask register (optional)
+    string op = symOp(*ip);
+
+    Value *dest = mkvector(nodes, 512, 16); // 512-bit vector with 16 elements
+    Value *src1 = readReg(op1->field[0]);
+    Value *src2 = readReg(op2->field[0]);
+
+    // Apply mask if present
+    if (maskOp) {
+        Value *mask = readReg(maskOp->field[0]);
+        for (int i = 0; i < 16; ++i) {
+            if (mask->getMaskBit(i)) {
+                Value *result = buildop2(op, src1->getElement(i), src2->getElement(i));
+                dest->setElement(i, result);
             } else {
-                cerr << "[Error]Unknown 4-operand instruction " << it->opcstr
-                     << " not handled!\n";
+                dest->setElement(i, src1->getElement(i)); // Keep original value
             }
-            break;
         }
-        default:
-            cerr << "all instructions: operand count > 3 not handled!\n";
-            break;
+    } else {
+        // No mask: perform the operation on all elements
+        for (int i = 0; i < 16; ++i) {
+            Value *result = buildop2(op, src1->getElement(i), src2->getElement(i));
+            dest->setElement(i, result);
+        }
+    }
+
+    writeReg(op0->field[0], dest);
+    return 0;
+}
+
+// vmovdqu32 dst, [mem] [, mask]: load 16 dwords
+int SEEngine::execVLoad()
+{
+    if (ip->oprnum < 2)
+    {
+        cerr << "[Error] " << ip->opcstr << " needs 2 operands!\n";
+        return 0;
+    }
+    Operand *op0 = ip->oprd[0];    // Destination (register)
+    Operand *maskOp = ip->oprnum > 2 ? ip->oprd[2] : nullptr; // Mask register (optional)
+
+    Value *dest = mkvector(nodes, 512, 16); // 512-bit vector with 16 elements
+    Value *mask = maskOp ? readReg(maskOp->field[0]) : nullptr;
+
+    for (int i = 0; i < 16; ++i) {
+        if (!mask || mask->getMaskBit(i)) {
+            Value *memVal = readMem(ip->raddr + i * 4, 4); // Read 32-bit element
+            dest->setElement(i, memVal);
+        } else {
+            dest->setElement(i, mkconst("0x00000000")); // Zero if not masked
         }
     }
+
+    writeReg(op0->field[0], dest);
+    return 0;
+}
+
+int SEEngine::execUnknown()
+{
+    cerr << "[Error] " << ip->id << ": " << ip->opcstr << " with "
+         << ip->oprnum << " operands not handled!\n";
     return 0;
 }
 
@@ -1441,7 +1449,7 @@ void traverse(Value * v){
             else if (v->valty == HYBRID)
             {
                 cout << "[hyb" << v->id << " ";
-                for (auto &kv : v->childs)
+                for (auto &kv : v->hyb->childs)
                 {
                     cout << "[" << kv.first.first << "," << kv.first.second << "]:";
                     traverse2(kv.second);
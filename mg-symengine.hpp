@@ -1,9 +1,13 @@
+#ifndef MG_SYMENGINE_HPP
+#define MG_SYMENGINE_HPP
+
 #include <map>
 #include <list>
 #include <vector>
 #include <string>
 
 #include "core.hpp"
+#include "semantics.hpp"
 
 using namespace std;
 // Example: If you previously had a typedef for ADDR32, replace it with ADDR64
@@ -15,6 +19,7 @@ typedef std::uint64_t ADDR64;
 
 struct Operation;
 struct Value;
+struct NodeArena;
 
 // Example placeholder for Inst and Operand (not shown in your snippet).
 
@@ -37,6 +42,17 @@ private:
     // Inputs from registers
     map<Value*, string> reginput;
 
+    // Owns every Value and Operation built by this engine
+    NodeArena *nodes;
+
+    // Node constructors; operations and constants are hash-consed
+    Value* mkconst(const string &con);
+    Value* hashcons(const string &opty, Value *v1, Value *v2, Value *v3);
+    Value* buildop1(string opty, Value *v1);
+    Value* buildop2(string opty, Value *v1, Value *v2);
+    Value* buildop3(string opty, Value *v1, Value *v2, Value *v3);
+    Value* writeVal(Value *from, Value *to, int start, int end);
+
     // Helper functions
     bool memfind(AddrRange ar) {
         map<AddrRange, Value*>::iterator ii = mem.find(ar);
@@ -61,9 +77,6 @@ private:
     Value* readMem(ADDR64 addr, int nbyte);
     void writeMem(ADDR64 addr, int nbyte, Value *v);
 
-    // Example commented-out function if you need it in 64-bit:
-    // void readornew(int64_t addr, int nbyte, Value *&v);
-
     // Return the concrete (numeric) value of a 64-bit register, if known
     ADDR64 getRegConVal(string reg);
 
@@ -72,63 +85,41 @@ private:
 
     void printformula(Value* v);
 
+    // One handler per SemForm; each executes the instruction at ip
+    typedef int (SEEngine::*ExecRule)();
+    static const ExecRule execRules[(int)SemForm::COUNT];
+    int execNoEffect();
+    int execPush();
+    int execPop();
+    int execMov();
+    int execLea();
+    int execXchg();
+    int execUnary();
+    int execBinary();
+    int execTernary();
+    int execVBinary();
+    int execVLoad();
+    int execUnknown();
+
 public:
-    // Update initialization list to reflect 64-bit registers
-    SEEngine() {
-        ctx = {
-            {"rax", nullptr},
-            {"rbx", nullptr},
-            {"rcx", nullptr},
-            {"rdx", nullptr},
-            {"rsi", nullptr},
-            {"rdi", nullptr},
-            {"rsp", nullptr},
-            {"rbp", nullptr}
-        };
-    }
+    SEEngine();
+    ~SEEngine();
+    SEEngine(const SEEngine &) = delete;
+    SEEngine &operator=(const SEEngine &) = delete;
 
-    // If you still want an init(...) that takes 8 values (for rax, rbx, etc.)
+    // Set rax..rbp to the given values and execute [it1, it2)
     void init(Value *v1, Value *v2, Value *v3, Value *v4,
               Value *v5, Value *v6, Value *v7, Value *v8,
               list<Inst>::iterator it1,
-              list<Inst>::iterator it2)
-    {
-        ctx["rax"] = v1;
-        ctx["rbx"] = v2;
-        ctx["rcx"] = v3;
-        ctx["rdx"] = v4;
-        ctx["rsi"] = v5;
-        ctx["rdi"] = v6;
-        ctx["rsp"] = v7;
-        ctx["rbp"] = v8;
-
-        start = it1;
-        end = it2;
-        ip = start;
-    }
+              list<Inst>::iterator it2);
 
     // Overloaded init if you don’t need specific reg values
     void init(list<Inst>::iterator it1,
-              list<Inst>::iterator it2)
-    {
-        start = it1;
-        end = it2;
-        ip = start;
-    }
+              list<Inst>::iterator it2);
 
     // Make all registers symbolic
     void initAllRegSymol(list<Inst>::iterator it1,
-                         list<Inst>::iterator it2)
-    {
-        start = it1;
-        end = it2;
-        ip = start;
-
-        // If you want to set them all to some symbolic value
-        // for (auto &r : ctx) {
-        //     r.second = makeSymbolicValue(...);
-        // }
-    }
+                         list<Inst>::iterator it2);
 
     int symexec();
 
@@ -171,3 +162,5 @@ vector<Value*> getInputVector(Value *f);
 
 // Possibly keep the same
 string getValueName(Value *v);
+
+#endif // MG_SYMENGINE_HPP
@@ -18,9 +18,12 @@
 #include <vector>
 #include <set>
 #include <regex>
+#include <algorithm>
+#include <unistd.h>  // for pread
 #include <cstdio>  // for printf, FILE*, etc.
 #include "core.hpp"
 #include "parser.hpp"
+#include "semantics.hpp"
 using namespace std;
 /*
 // ---------------------------------------------------------------------------
@@ -182,6 +185,70 @@ static Operand* createDataOperand(const std::string &s)
     return opr;
 }
 
+// ---------------------------------------------------------------------------
+// splitAddr(...) - fill opr->field[] from an address expression whose tag
+//   is already set. Layout per tag (what SEEngine::calcAddr reads):
+//     7: base, index, scale, sign, disp    4: base, sign, disp
+//     6: index, scale, sign, disp          3: index, scale
+//     5: base, index, scale                2: base
+//     1: disp
+// ---------------------------------------------------------------------------
+static void splitAddr(const std::string &s, Operand *opr)
+{
+    std::string base, index, scale, sign, disp;
+    size_t pos = 0;
+    while (pos < s.size()) {
+        size_t next = s.find_first_of("+-", pos + 1);
+        std::string term = s.substr(pos, next == std::string::npos ? std::string::npos : next - pos);
+        pos = (next == std::string::npos) ? s.size() : next;
+
+        std::string termsign;
+        if (term[0] == '+' || term[0] == '-') {
+            termsign = term.substr(0, 1);
+            term = term.substr(1);
+        }
+        size_t star = term.find('*');
+        if (star != std::string::npos) {
+            index = term.substr(0, star);
+            scale = term.substr(star + 1);
+        } else if (term.compare(0, 2, "0x") == 0) {
+            sign = termsign.empty() ? "+" : termsign;
+            disp = term;
+        } else {
+            base = term;
+        }
+    }
+
+    switch (opr->tag) {
+    case 7:
+        opr->field[0] = base;  opr->field[1] = index; opr->field[2] = scale;
+        opr->field[3] = sign;  opr->field[4] = disp;
+        break;
+    case 6:
+        opr->field[0] = index; opr->field[1] = scale;
+        opr->field[2] = sign;  opr->field[3] = disp;
+        break;
+    case 5:
+        opr->field[0] = base;  opr->field[1] = index; opr->field[2] = scale;
+        break;
+    case 4:
+        opr->field[0] = base;  opr->field[1] = sign;  opr->field[2] = disp;
+        break;
+    case 3:
+        opr->field[0] = index; opr->field[1] = scale;
+        break;
+    case 2:
+        opr->field[0] = base;
+        break;
+    case 1:
+        opr->field[0] = disp;
+        break;
+    default:
+        opr->field[0] = s;
+        break;
+    }
+}
+
 // ---------------------------------------------------------------------------
 // createAddrOperand(...) - parse memory expressions, inc. "rip+0x189b5"
 // ---------------------------------------------------------------------------
@@ -235,37 +302,37 @@ static Operand* createAddrOperand(const std::string &s)
     if      (std::regex_match(s, m, addr7)) {
         opr->ty = OperandType::MEM;
         opr->tag = 7;
-        opr->field[0] = s;
+        splitAddr(s, opr);
     }
     else if (std::regex_match(s, m, addr6)) {
         opr->ty = OperandType::MEM;
         opr->tag = 6;
-        opr->field[0] = s;
+        splitAddr(s, opr);
     }
     else if (std::regex_match(s, m, addr5)) {
         opr->ty = OperandType::MEM;
         opr->tag = 5;
-        opr->field[0] = s;
+        splitAddr(s, opr);
     }
     else if (std::regex_match(s, m, addr4)) {
         opr->ty = OperandType::MEM;
         opr->tag = 4;
-        opr->field[0] = s;
+        splitAddr(s, opr);
     }
     else if (std::regex_match(s, m, addr3)) {
         opr->ty = OperandType::MEM;
         opr->tag = 3;
-        opr->field[0] = s;
+        splitAddr(s, opr);
     }
     else if (std::regex_match(s, m, addr2)) {
         opr->ty = OperandType::MEM;
         opr->tag = 2;
-        opr->field[0] = s;
+        splitAddr(s, opr);
     }
     else if (std::regex_match(s, m, addr1)) {
         opr->ty = OperandType::MEM;
         opr->tag = 1;
-        opr->field[0] = s;
+        splitAddr(s, opr);
     }
     else {
         std::cerr << "[createAddrOperand] Unknown extended mem operand: " << s << "\n";
@@ -315,12 +382,169 @@ static Operand* createOperand(const std::string &s)
 // ---------------------------------------------------------------------------
 // parseOperand(...) - parse each Inst's raw oprs[] strings into Operand
 // ---------------------------------------------------------------------------
+void parseOperand(Inst &ins)
+{
+    for (int i = 0; i < (int)ins.oprs.size() && i < 4; i++) {
+        ins.oprd[i] = createOperand(ins.oprs[i]);
+    }
+}
+
 void parseOperand(std::list<Inst>::iterator begin,
                   std::list<Inst>::iterator end)
 {
     for (auto it = begin; it != end; ++it) {
-        for (int i = 0; i < (int)it->oprs.size() && i < 3; i++) {
-            it->oprd[i] = createOperand(it->oprs[i]);
+        parseOperand(*it);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// releaseOperand(...) - free the Operand structures of an instruction that
+//   is not kept around (streaming readers)
+// ---------------------------------------------------------------------------
+void releaseOperand(Inst &ins)
+{
+    for (int i = 0; i < 4; i++) {
+        delete ins.oprd[i];
+        ins.oprd[i] = nullptr;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// parseInst(...) - parse one trace line into ins
+//   - returns false for lines that carry no instruction (empty, "nop",
+//     '#' comment or fold record)
+// ---------------------------------------------------------------------------
+bool parseInst(const std::string &line, int id, Inst &ins)
+{
+    if (line.empty() || line[0] == '#') return false;
+
+    std::istringstream strbuf(line);
+    std::string temp, disas;
+
+    ins.id = id;
+    for (int i = 0; i < 4; i++) ins.oprd[i] = nullptr;
+    for (int i = 0; i < 8; i++) ins.ctxreg[i] = 0;
+    ins.raddr = ins.waddr = 0;
+
+    // 1) Instruction address
+    std::getline(strbuf, ins.addr, ';');
+    // if ins.addr is blank => skip
+    if (ins.addr.empty()) return false;
+    // convert to 64-bit
+    ins.addrn = std::stoull(ins.addr, nullptr, 16);
+
+    // 2) Disassembly
+    std::getline(strbuf, disas, ';');
+    ins.assembly = disas;
+
+    // parse out the opcode from the first token
+    {
+        std::istringstream dbuf(disas);
+        std::getline(dbuf, ins.opcstr, ' ');
+        // If the opcode is "nop", skip the rest
+        if (ins.opcstr == "nop") {
+            return false;
+        }
+        // Else gather potential operands
+        while (dbuf.good()) {
+            std::getline(dbuf, temp, ',');
+            if (!temp.empty()) {
+                // trim
+                auto st = temp.find_first_not_of(" \t");
+                if (st != std::string::npos) temp = temp.substr(st);
+                auto en = temp.find_last_not_of(" \t");
+                if (en != std::string::npos) temp = temp.substr(0, en+1);
+
+                if (!temp.empty()) {
+                    ins.oprs.push_back(temp);
+                }
+            }
+        }
+    }
+    ins.oprnum = ins.oprs.size();
+    ins.desc = getOpDesc(ins.opcstr, ins.oprnum);
+
+    // 3) Next 8 context registers
+    for (int i = 0; i < 8; i++) {
+        if (!std::getline(strbuf, temp, ',')) break;
+        ins.ctxreg[i] = std::stoull(temp, nullptr, 16);
+    }
+    // 4) read/write addresses
+    if (std::getline(strbuf, temp, ',')) {
+        ins.raddr = std::stoull(temp, nullptr, 16);
+    }
+    if (std::getline(strbuf, temp, ',')) {
+        ins.waddr = std::stoull(temp, nullptr, 16);
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Folded traces (see printTraceFoldedLLSE). A run of <iters> repetitions of
+//   the same <period> static instructions is stored once:
+//     #fold <iters> <period>
+//     <period trace lines of the first iteration>
+//     #stride dr,dw;dr,dw;...     the same step for every later iteration, or
+//     #delta dr,dw;dr,dw;...      one line per later iteration
+//   dr/dw are the signed hex raddr/waddr changes of each instruction from
+//   the previous iteration. Later iterations reuse the context registers of
+//   the first one. Any other line starting with '#' is a comment.
+// ---------------------------------------------------------------------------
+static bool parseFoldDelta(const std::string &line, size_t skip, int period,
+                           std::vector<std::pair<int64_t, int64_t>> &d)
+{
+    d.clear();
+    std::istringstream strbuf(line.substr(skip));
+    std::string pairtxt;
+    while (std::getline(strbuf, pairtxt, ';')) {
+        size_t comma = pairtxt.find(',');
+        if (comma == std::string::npos) return false;
+        d.push_back({std::stoll(pairtxt.substr(0, comma), nullptr, 16),
+                     std::stoll(pairtxt.substr(comma + 1), nullptr, 16)});
+    }
+    return (int)d.size() == period;
+}
+
+static void expandFold(std::ifstream *infile, const std::string &header,
+                       int &num, std::list<Inst> *L)
+{
+    int iters = 0, period = 0;
+    std::istringstream hbuf(header.substr(6));
+    if (!(hbuf >> iters >> period) || iters < 1 || period < 1) {
+        std::cerr << "[parseTrace] bad fold record: " << header << "\n";
+        return;
+    }
+
+    std::string line;
+    std::vector<Inst> body;
+    while ((int)body.size() < period && std::getline(*infile, line)) {
+        Inst ins;
+        if (parseInst(line, 0, ins)) body.push_back(ins);
+    }
+
+    std::vector<std::pair<int64_t, int64_t>> step;
+    bool stride = false;
+    for (int it = 0; it < iters && (int)body.size() == period; it++) {
+        if (it > 0 && !stride) {
+            if (!std::getline(*infile, line)) break;
+            if (line.compare(0, 8, "#stride ") == 0) {
+                stride = true;
+                if (!parseFoldDelta(line, 8, period, step)) break;
+            }
+            else if (line.compare(0, 7, "#delta ") != 0 ||
+                     !parseFoldDelta(line, 7, period, step)) {
+                std::cerr << "[parseTrace] bad fold delta: " << line << "\n";
+                return;
+            }
+        }
+        for (int i = 0; i < period; i++) {
+            if (it > 0) {
+                body[i].raddr += step[i].first;
+                body[i].waddr += step[i].second;
+            }
+            Inst ins = body[i];
+            ins.id = num++;
+            L->push_back(ins);
         }
     }
 }
@@ -333,70 +557,100 @@ void parseTrace(std::ifstream *infile, std::list<Inst> *L)
 {
     std::string line;
     int num = 1;
+    std::streamoff off = infile->tellg();
 
     while (std::getline(*infile, line)) {
+        std::streamoff lineoff = off;
+        // getline hits EOF only on a last line without a newline
+        uint32_t linelen = line.size() + (infile->eof() ? 0 : 1);
+        off += linelen;
         if (line.empty()) continue;
-
-        std::istringstream strbuf(line);
-        std::string temp, disas;
+        if (line[0] == '#') {
+            if (line.compare(0, 6, "#fold ") == 0) {
+                // expanded instructions keep no file offset
+                expandFold(infile, line, num, L);
+                off = infile->tellg();
+            }
+            continue;
+        }
 
         // Build a new Inst
         Inst ins;
-        ins.id = num++;
-
-        // 1) Instruction address
-        std::getline(strbuf, ins.addr, ';');
-        // if ins.addr is blank => skip
-        if (ins.addr.empty()) continue;
-        // convert to 64-bit
-        ins.addrn = std::stoull(ins.addr, nullptr, 16);
-
-        // 2) Disassembly
-        std::getline(strbuf, disas, ';');
-        ins.assembly = disas;
-
-        // parse out the opcode from the first token
-        {
-            std::istringstream dbuf(disas);
-            std::getline(dbuf, ins.opcstr, ' ');
-            // If the opcode is "nop", skip the rest
-            if (ins.opcstr == "nop") {
-                // ignore or push anyway? If you truly want to skip, do:
-                continue;
-            }
-            // Else gather potential operands
-            while (dbuf.good()) {
-                std::getline(dbuf, temp, ',');
-                if (!temp.empty()) {
-                    // trim
-                    auto st = temp.find_first_not_of(" \t");
-                    if (st != std::string::npos) temp = temp.substr(st);
-                    auto en = temp.find_last_not_of(" \t");
-                    if (en != std::string::npos) temp = temp.substr(0, en+1);
-
-                    if (!temp.empty()) {
-                        ins.oprs.push_back(temp);
-                    }
-                }
-            }
+        if (parseInst(line, num++, ins)) {
+            ins.off = lineoff;
+            ins.len = linelen;
+            L->push_back(ins);
         }
-        ins.oprnum = ins.oprs.size();
+    }
+}
 
-        // 3) Next 8 context registers
-        for (int i = 0; i < 8; i++) {
-            if (!std::getline(strbuf, temp, ',')) break;
-            ins.ctxreg[i] = std::stoull(temp, nullptr, 16);
+// ---------------------------------------------------------------------------
+// TraceReader - hand out one instruction at a time; only the current line
+//   and instruction are held in memory
+// ---------------------------------------------------------------------------
+bool TraceReader::next(Inst &ins)
+{
+    while (std::getline(*infile, buf)) {
+        if (buf.empty()) continue;
+        ins = Inst();
+        if (parseInst(buf, num++, ins)) {
+            parseOperand(ins);
+            return true;
+        }
+    }
+    return false;
+}
+
+// ---------------------------------------------------------------------------
+// ReverseTraceReader - hand out instructions last to first; only the
+//   current block (plus one partial line) is held in memory
+// ---------------------------------------------------------------------------
+bool ReverseTraceReader::prevLine()
+{
+    for (;;) {
+        // The line ends at cur; drop its newline
+        size_t end = cur;
+        if (end > 0 && buf[end - 1] == '\n') end--;
+
+        size_t nl = (end > 0) ? buf.rfind('\n', end - 1) : std::string::npos;
+        if (nl != std::string::npos) {
+            text.assign(buf, nl + 1, end - nl - 1);
+            off = pos + (off_t)(nl + 1);
+            cur = nl + 1;
+            return true;
         }
-        // 4) read/write addresses
-        if (std::getline(strbuf, temp, ',')) {
-            ins.raddr = std::stoull(temp, nullptr, 16);
+        if (pos == 0) {
+            if (cur == 0) return false;
+            text.assign(buf, 0, end);
+            off = 0;
+            cur = 0;
+            return true;
         }
-        if (std::getline(strbuf, temp, ',')) {
-            ins.waddr = std::stoull(temp, nullptr, 16);
+
+        // No line start in the buffer yet: prepend the previous block
+        size_t n = std::min((off_t)blocksize, pos);
+        std::string blk(n, '\0');
+        pos -= n;
+        if (pread(fd, &blk[0], n, pos) != (ssize_t)n) {
+            std::cerr << "[ReverseTraceReader] read error at offset " << pos << "\n";
+            return false;
         }
+        buf = blk + buf.substr(0, cur);
+        cur = buf.size();
+    }
+}
 
-        L->push_back(ins);
+bool ReverseTraceReader::prev(Inst &ins)
+{
+    while (prevLine()) {
+        if (text.empty()) continue;
+        ins = Inst();
+        if (parseInst(text, 0, ins)) {
+            parseOperand(ins);
+            return true;
+        }
     }
+    return false;
 }
 
 // ---------------------------------------------------------------------------
@@ -421,6 +675,45 @@ void printfirst3inst(std::list<Inst> *L)
     }
 }
 
+// ---------------------------------------------------------------------------
+// printInstHuman(...) / printInstLLSE(...) - write one instruction line
+// ---------------------------------------------------------------------------
+static void printInstHuman(FILE *fp, const Inst &ins)
+{
+    fprintf(fp, "%s %s  \t", ins.addr.c_str(), ins.assembly.c_str());
+    fprintf(fp, "(%llx, %llx)\n",
+            (unsigned long long)ins.raddr,
+            (unsigned long long)ins.waddr);
+}
+
+void printInstLLSE(FILE *fp, const Inst &ins)
+{
+    fprintf(fp, "%s;%s;", ins.addr.c_str(), ins.assembly.c_str());
+    for (int i = 0; i < 8; i++) {
+        fprintf(fp, "%llx,", (unsigned long long)ins.ctxreg[i]);
+    }
+    fprintf(fp, "%llx,%llx,\n",
+            (unsigned long long)ins.raddr,
+            (unsigned long long)ins.waddr);
+}
+
+// ---------------------------------------------------------------------------
+// printTraceSelected(...) - write only the instructions whose id is in ids.
+//   ids must be sorted ascending; L is walked once, nothing is copied.
+// ---------------------------------------------------------------------------
+static void printTraceSelected(std::list<Inst> &L, const std::vector<int> &ids,
+                               FILE *fp, void (*printInst)(FILE *, const Inst &))
+{
+    auto idit = ids.begin();
+    for (auto it = L.begin(); it != L.end() && idit != ids.end(); ++it) {
+        while (idit != ids.end() && *idit < it->id) ++idit;
+        if (idit != ids.end() && *idit == it->id) {
+            printInst(fp, *it);
+            ++idit;
+        }
+    }
+}
+
 // ---------------------------------------------------------------------------
 // printTraceHuman(...)
 // ---------------------------------------------------------------------------
@@ -432,14 +725,22 @@ void printTraceHuman(std::list<Inst> &L, std::string fname)
         return;
     }
     for (auto &ins : L) {
-        fprintf(fp, "%s %s  \t", ins.addr.c_str(), ins.assembly.c_str());
-        fprintf(fp, "(%llx, %llx)\n",
-                (unsigned long long)ins.raddr,
-                (unsigned long long)ins.waddr);
+        printInstHuman(fp, ins);
     }
     fclose(fp);
 }
 
+void printTraceHuman(std::list<Inst> &L, const std::vector<int> &ids, std::string fname)
+{
+    FILE *fp = fopen(fname.c_str(), "w");
+    if (!fp) {
+        std::cerr << "[printTraceHuman] Cannot open " << fname << "\n";
+        return;
+    }
+    printTraceSelected(L, ids, fp, printInstHuman);
+    fclose(fp);
+}
+
 // ---------------------------------------------------------------------------
 // printTraceLLSE(...)
 // ---------------------------------------------------------------------------
@@ -451,17 +752,160 @@ void printTraceLLSE(std::list<Inst> &L, std::string fname)
         return;
     }
     for (auto &ins : L) {
-        fprintf(fp, "%s;%s;", ins.addr.c_str(), ins.assembly.c_str());
-        for (int i = 0; i < 8; i++) {
-            fprintf(fp, "%llx,", (unsigned long long)ins.ctxreg[i]);
+        printInstLLSE(fp, ins);
+    }
+    fclose(fp);
+}
+
+void printTraceLLSE(std::list<Inst> &L, const std::vector<int> &ids, std::string fname)
+{
+    FILE *fp = fopen(fname.c_str(), "w");
+    if (!fp) {
+        std::cerr << "[printTraceLLSE] Cannot open " << fname << "\n";
+        return;
+    }
+    printTraceSelected(L, ids, fp, printInstLLSE);
+    fclose(fp);
+}
+
+// ---------------------------------------------------------------------------
+// printTraceFoldedLLSE(...) / printTraceFoldedHuman(...) - like the id-list
+//   printers, but repeated static-instruction sequences (loop or dispatcher
+//   iterations) are written once as a fold record; see expandFold for the
+//   format. The human variant writes the fold header and first iteration
+//   only.
+// ---------------------------------------------------------------------------
+static const int MAXFOLDPERIOD = 64;
+
+// Best fold starting at v[i]: the period that covers the most instructions
+// with at least two iterations. iters is 1 if nothing repeats.
+static void findFold(const std::vector<const Inst *> &v, size_t i,
+                     int &period, size_t &iters)
+{
+    size_t best = 0;
+    period = 1;
+    iters = 1;
+    for (int p = 1; p <= MAXFOLDPERIOD && i + 2 * p <= v.size(); p++) {
+        size_t r = 0;
+        while (i + p + r < v.size() && v[i + r]->addrn == v[i + p + r]->addrn) r++;
+        size_t k = 1 + r / p;
+        if (k >= 2 && k * p > best) {
+            best = k * p;
+            period = p;
+            iters = k;
+        }
+    }
+}
+
+typedef std::vector<std::pair<int64_t, int64_t>> FoldDelta;
+
+// raddr/waddr changes of each later iteration of the fold (p, k) at v[i];
+// returns true if they are all the same (a #stride fold)
+static bool foldDeltas(const std::vector<const Inst *> &v, size_t i, int p, size_t k,
+                       std::vector<FoldDelta> &deltas)
+{
+    bool stride = true;
+    deltas.assign(k - 1, FoldDelta(p));
+    for (size_t it = 1; it < k; it++) {
+        for (int j = 0; j < p; j++) {
+            const Inst *cur = v[i + it * p + j], *prv = v[i + (it - 1) * p + j];
+            deltas[it - 1][j] = {(int64_t)(cur->raddr - prv->raddr),
+                                 (int64_t)(cur->waddr - prv->waddr)};
+        }
+        if (deltas[it - 1] != deltas[0]) stride = false;
+    }
+    return stride;
+}
+
+void printFoldLLSE(FILE *fp, const std::vector<const Inst *> &v, size_t i, int p, size_t k)
+{
+    std::vector<FoldDelta> deltas;
+    bool stride = foldDeltas(v, i, p, k, deltas);
+
+    fprintf(fp, "#fold %zu %d\n", k, p);
+    for (int j = 0; j < p; j++) {
+        printInstLLSE(fp, *v[i + j]);
+    }
+    for (size_t it = 0; it < (stride ? std::min(k - 1, (size_t)1) : k - 1); it++) {
+        fputs(stride ? "#stride " : "#delta ", fp);
+        for (int j = 0; j < p; j++) {
+            int64_t dr = deltas[it][j].first, dw = deltas[it][j].second;
+            fprintf(fp, "%s%s%llx,%s%llx", j ? ";" : "",
+                    dr < 0 ? "-" : "", (unsigned long long)(dr < 0 ? -dr : dr),
+                    dw < 0 ? "-" : "", (unsigned long long)(dw < 0 ? -dw : dw));
+        }
+        fputc('\n', fp);
+    }
+}
+
+static void printFolded(const std::vector<const Inst *> &v, FILE *fp, bool human)
+{
+    size_t i = 0;
+    while (i < v.size()) {
+        int p;
+        size_t k;
+        findFold(v, i, p, k);
+
+        // The header, one iteration and the delta lines must be shorter
+        // than the k * p instructions they stand for; otherwise print the
+        // whole scanned run as is, since no later start inside it folds
+        // better
+        size_t ndelta = 0;
+        if (!human && k >= 2) {
+            std::vector<FoldDelta> deltas;
+            ndelta = foldDeltas(v, i, p, k, deltas) ? 1 : k - 1;
+        }
+        if (k < 2 || 1 + (size_t)p + ndelta >= k * p) {
+            for (size_t j = 0; j < k * p; j++) {
+                if (human) printInstHuman(fp, *v[i + j]);
+                else printInstLLSE(fp, *v[i + j]);
+            }
+        }
+        else if (human) {
+            fprintf(fp, "#fold %zu %d\n", k, p);
+            for (int j = 0; j < p; j++) {
+                printInstHuman(fp, *v[i + j]);
+            }
+        }
+        else {
+            printFoldLLSE(fp, v, i, p, k);
         }
-        fprintf(fp, "%llx,%llx,\n",
-                (unsigned long long)ins.raddr,
-                (unsigned long long)ins.waddr);
+        i += k * p;
     }
+}
+
+static void printTraceFolded(std::list<Inst> &L, const std::vector<int> &ids,
+                             std::string fname, bool human)
+{
+    FILE *fp = fopen(fname.c_str(), "w");
+    if (!fp) {
+        std::cerr << "[printTraceFolded] Cannot open " << fname << "\n";
+        return;
+    }
+    std::vector<const Inst *> v;
+    v.reserve(ids.size());
+    auto idit = ids.begin();
+    for (auto it = L.begin(); it != L.end() && idit != ids.end(); ++it) {
+        while (idit != ids.end() && *idit < it->id) ++idit;
+        if (idit != ids.end() && *idit == it->id) {
+            v.push_back(&*it);
+            ++idit;
+        }
+    }
+    printFolded(v, fp, human);
     fclose(fp);
 }
 
+void printTraceFoldedLLSE(std::list<Inst> &L, const std::vector<int> &ids, std::string fname)
+{
+    printTraceFolded(L, ids, fname, false);
+}
+
+void printTraceFoldedHuman(std::list<Inst> &L, const std::vector<int> &ids, std::string fname)
+{
+    printTraceFolded(L, ids, fname, true);
+}
+
 // ---------------------------------------------------------------------------
 // main for testing
 // ---------------------------------------------------------------------------
@@ -2,16 +2,77 @@
 #define PARSER_HPP
 
 
+#include <cstdio>
 #include <fstream>
 #include <list>
 #include <string>
+#include <vector>
+#include <sys/types.h>
 
 #include "core.hpp"
 using namespace std;
 void parseOperand(list<Inst>::iterator begin, list<Inst>::iterator end);
+void parseOperand(Inst &ins);
+void releaseOperand(Inst &ins);
+bool parseInst(const string &line, int id, Inst &ins);
 void parseTrace(ifstream *infile, list<Inst> *L);
 void printfirst3inst(list<Inst> *L);
 void printTraceLLSE(list<Inst> &L, string fname);
 void printTraceHuman(list<Inst> &L, string fname);
+// Print only the instructions of L whose id is in the ascending list ids
+void printTraceLLSE(list<Inst> &L, const vector<int> &ids, string fname);
+void printTraceHuman(list<Inst> &L, const vector<int> &ids, string fname);
+// Same, with repeated instruction sequences folded into "#fold" records,
+// which parseTrace expands again
+void printTraceFoldedLLSE(list<Inst> &L, const vector<int> &ids, string fname);
+void printTraceFoldedHuman(list<Inst> &L, const vector<int> &ids, string fname);
+// One instruction in the LLSE trace format
+void printInstLLSE(FILE *fp, const Inst &ins);
+// One "#fold" record (LLSE lines plus deltas) for k iterations of the
+// p instructions starting at v[i]; see parseTrace
+void printFoldLLSE(FILE *fp, const vector<const Inst *> &v, size_t i, int p, size_t k);
+
+// Streams a trace one instruction at a time (operands parsed), so traces
+// larger than memory can be processed. Call releaseOperand() on each
+// instruction once done with it. "#fold" records are skipped, not
+// expanded: read folded traces with parseTrace.
+class TraceReader {
+public:
+    TraceReader(ifstream *in) : infile(in), num(1) {}
+    bool next(Inst &ins);
+    // Raw text of the instruction last returned by next()
+    const string &line() const { return buf; }
+
+private:
+    ifstream *infile;
+    string buf;
+    int num;
+};
+
+// Streams a trace backwards, last line first, reading 'block' bytes at a
+// time from the end of the file. Instruction IDs are not known in this
+// direction, so each instruction is identified by the byte offset of its
+// line instead (id is left 0). Call releaseOperand() on each instruction
+// once done with it.
+class ReverseTraceReader {
+public:
+    ReverseTraceReader(int fd, off_t size, size_t block = 1 << 20)
+        : fd(fd), pos(size), cur(0), blocksize(block) {}
+    bool prev(Inst &ins);
+    // Raw text and file offset of the instruction last returned by prev()
+    const string &line() const { return text; }
+    off_t offset() const { return off; }
+
+private:
+    bool prevLine();
+
+    int fd;
+    off_t pos;          // file offset of buf[0]
+    string buf;         // buf[0, cur) is not yet consumed
+    size_t cur;
+    size_t blocksize;
+    string text;
+    off_t off = 0;
+};
 
 #endif 
@@ -0,0 +1,160 @@
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "semantics.hpp"
+
+using namespace std;
+
+/*
+ * The opcode descriptor table. Rows with a specific operand count take
+ * precedence over rows with -1 for the same mnemonic.
+ */
+static const OpDesc optable[] = {
+    // no data dependencies
+    {"test",   -1, SemForm::NOEFFECT, nullptr},
+    {"cmp",    -1, SemForm::NOEFFECT, nullptr},
+    {"call",   -1, SemForm::NOEFFECT, nullptr},
+    {"ret",    -1, SemForm::NOEFFECT, nullptr},
+    {"jmp",    -1, SemForm::NOEFFECT, nullptr},
+    {"jo",     -1, SemForm::NOEFFECT, nullptr},
+    {"jno",    -1, SemForm::NOEFFECT, nullptr},
+    {"js",     -1, SemForm::NOEFFECT, nullptr},
+    {"jns",    -1, SemForm::NOEFFECT, nullptr},
+    {"je",     -1, SemForm::NOEFFECT, nullptr},
+    {"jz",     -1, SemForm::NOEFFECT, nullptr},
+    {"jne",    -1, SemForm::NOEFFECT, nullptr},
+    {"jnz",    -1, SemForm::NOEFFECT, nullptr},
+    {"jb",     -1, SemForm::NOEFFECT, nullptr},
+    {"jnae",   -1, SemForm::NOEFFECT, nullptr},
+    {"jc",     -1, SemForm::NOEFFECT, nullptr},
+    {"jnb",    -1, SemForm::NOEFFECT, nullptr},
+    {"jae",    -1, SemForm::NOEFFECT, nullptr},
+    {"jnc",    -1, SemForm::NOEFFECT, nullptr},
+    {"jbe",    -1, SemForm::NOEFFECT, nullptr},
+    {"jna",    -1, SemForm::NOEFFECT, nullptr},
+    {"ja",     -1, SemForm::NOEFFECT, nullptr},
+    {"jnbe",   -1, SemForm::NOEFFECT, nullptr},
+    {"jl",     -1, SemForm::NOEFFECT, nullptr},
+    {"jnge",   -1, SemForm::NOEFFECT, nullptr},
+    {"jge",    -1, SemForm::NOEFFECT, nullptr},
+    {"jnl",    -1, SemForm::NOEFFECT, nullptr},
+    {"jle",    -1, SemForm::NOEFFECT, nullptr},
+    {"jng",    -1, SemForm::NOEFFECT, nullptr},
+    {"jg",     -1, SemForm::NOEFFECT, nullptr},
+    {"jnle",   -1, SemForm::NOEFFECT, nullptr},
+    {"jp",     -1, SemForm::NOEFFECT, nullptr},
+    {"jpe",    -1, SemForm::NOEFFECT, nullptr},
+    {"jnp",    -1, SemForm::NOEFFECT, nullptr},
+    {"jpo",    -1, SemForm::NOEFFECT, nullptr},
+    {"jcxz",   -1, SemForm::NOEFFECT, nullptr},
+    {"jecxz",  -1, SemForm::NOEFFECT, nullptr},
+
+    // stack
+    {"push",    1, SemForm::PUSH,     nullptr},
+    {"pop",     1, SemForm::POP,      nullptr},
+
+    // moves
+    {"mov",     2, SemForm::MOV,      nullptr},
+    {"movzx",   2, SemForm::MOV,      nullptr},
+    {"movsx",   2, SemForm::MOV,      nullptr},
+    {"movsxd",  2, SemForm::MOV,      nullptr},
+    {"movabs",  2, SemForm::MOV,      nullptr},
+    {"lea",     2, SemForm::LEA,      nullptr},
+    {"xchg",    2, SemForm::XCHG,     nullptr},
+
+    // arithmetic and logic
+    {"inc",     1, SemForm::UNARY,    "inc"},
+    {"dec",     1, SemForm::UNARY,    "dec"},
+    {"neg",     1, SemForm::UNARY,    "neg"},
+    {"not",     1, SemForm::UNARY,    "not"},
+    {"add",     2, SemForm::BINARY,   "add"},
+    {"adc",     2, SemForm::BINARY,   "adc"},
+    {"sub",     2, SemForm::BINARY,   "sub"},
+    {"sbb",     2, SemForm::BINARY,   "sbb"},
+    {"and",     2, SemForm::BINARY,   "and"},
+    {"or",      2, SemForm::BINARY,   "or"},
+    {"xor",     2, SemForm::BINARY,   "xor"},
+    {"shl",     2, SemForm::BINARY,   "shl"},
+    {"sal",     2, SemForm::BINARY,   "shl"},
+    {"shr",     2, SemForm::BINARY,   "shr"},
+    {"sar",     2, SemForm::BINARY,   "sar"},
+    {"rol",     2, SemForm::BINARY,   "rol"},
+    {"ror",     2, SemForm::BINARY,   "ror"},
+    {"imul",    2, SemForm::BINARY,   "imul"},
+    {"imul",    3, SemForm::TERNARY,  "imul"},
+
+    // vector
+    {"vpaddd",  -1, SemForm::VBINARY, "add"},
+    {"vmovdqu32", -1, SemForm::VLOAD, nullptr},
+};
+
+// Generic rows for mnemonics the table does not know
+static const OpDesc genericNone    = {"", 0,  SemForm::NOEFFECT, nullptr};
+static const OpDesc genericUnary   = {"", 1,  SemForm::UNARY,    nullptr};
+static const OpDesc genericBinary  = {"", 2,  SemForm::BINARY,   nullptr};
+static const OpDesc genericUnknown = {"", -1, SemForm::UNKNOWN,  nullptr};
+
+const OpDesc *getOpDesc(const string &mnem, int oprnum)
+{
+    static unordered_map<string, vector<const OpDesc *>> index;
+    if (index.empty()) {
+        for (auto &row : optable) {
+            index[row.mnem].push_back(&row);
+        }
+    }
+
+    auto it = index.find(mnem);
+    if (it != index.end()) {
+        const OpDesc *any = nullptr;
+        for (const OpDesc *row : it->second) {
+            if (row->oprnum == oprnum) return row;
+            if (row->oprnum == -1) any = row;
+        }
+        if (any) return any;
+    }
+
+    switch (oprnum) {
+    case 0:  return &genericNone;
+    case 1:  return &genericUnary;
+    case 2:  return &genericBinary;
+    default: return &genericUnknown;
+    }
+}
+
+const OpDesc *opDesc(const Inst &ins)
+{
+    return ins.desc ? ins.desc : getOpDesc(ins.opcstr, ins.oprnum);
+}
+
+string symOp(const Inst &ins)
+{
+    const OpDesc *d = opDesc(ins);
+    return d->symop ? string(d->symop) : ins.opcstr;
+}
+
+/*
+ * Field layout of a memory operand per tag (see createAddrOperand):
+ *   7: base, index, scale, sign, disp    4: base, sign, disp
+ *   6: index, scale, sign, disp          3: index, scale
+ *   5: base, index, scale                2: base
+ *   1: disp
+ */
+int addrRegs(const Operand *opr, string regs[2])
+{
+    switch (opr->tag) {
+    case 7:
+    case 5:
+        regs[0] = opr->field[0];
+        regs[1] = opr->field[1];
+        return 2;
+    case 6:
+    case 4:
+    case 3:
+    case 2:
+        regs[0] = opr->field[0];
+        return 1;
+    default:
+        return 0;
+    }
+}
@@ -0,0 +1,54 @@
+#ifndef SEMANTICS_HPP
+#define SEMANTICS_HPP
+
+#include <string>
+
+#include "core.hpp"
+
+using std::string;
+
+/*
+ * How an instruction form moves data between its operands. The slicer
+ * (def/use parameters) and the symbolic engine (formulas) both dispatch
+ * on this, so coverage is extended in one place: the table in
+ * semantics.cpp.
+ */
+enum class SemForm {
+    NOEFFECT,   // no data flow: jumps, cmp, test, call, ret
+    PUSH,       // [rsp] <- op0
+    POP,        // op0 <- [rsp]
+    MOV,        // op0 <- op1
+    LEA,        // op0 <- address expression of op1
+    XCHG,       // op0 <-> op1
+    UNARY,      // op0 <- symop op0
+    BINARY,     // op0 <- op0 symop op1
+    TERNARY,    // op0 <- op1 symop op2           (imul r, r/m, imm)
+    VBINARY,    // op0 <- op1 symop op2 per lane  (vpaddd)
+    VLOAD,      // op0 <- [mem] per lane          (vmovdqu32)
+    UNKNOWN,    // not modelled: consumers report an error
+    COUNT
+};
+
+// One row of the opcode descriptor table
+struct OpDesc {
+    const char *mnem;
+    int oprnum;          // operand count the row applies to, -1 for any
+    SemForm form;
+    const char *symop;   // operator in symbolic formulas; nullptr = mnemonic
+};
+
+// Descriptor for a mnemonic with 'oprnum' operands. Mnemonics not in the
+// table fall back to a generic row chosen by operand count.
+const OpDesc *getOpDesc(const string &mnem, int oprnum);
+
+// ins.desc as set by the parser, or a fresh lookup otherwise
+const OpDesc *opDesc(const Inst &ins);
+
+// Symbolic operator of an instruction (the mnemonic if the row has none)
+string symOp(const Inst &ins);
+
+// Registers read by a memory operand's address expression (base first);
+// returns how many were stored in regs
+int addrRegs(const Operand *opr, string regs[2]);
+
+#endif // SEMANTICS_HPP
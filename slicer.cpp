@@ -7,523 +7,1623 @@
 #include <stack>
 #include <vector>
 #include <set>
+#include <unordered_map>
 #include <cstdint>     // for uint64_t
+#include <cstdio>      // for FILE, fwrite, etc.
+#include <cstdlib>     // for atoi
+#include <cstring>     // for memcmp
 #include <algorithm>   // for std::next, std::distance, etc.
+#include <deque>
+#include <functional>
+#include <stdexcept>   // for logic_error
+#include <mutex>
+#include <thread>
+#include <fcntl.h>     // for open
+#include <sys/stat.h>  // for fstat
+#include <unistd.h>    // for pread, close
 
 using namespace std;
 
 #include "core.hpp"    // Make sure Parameter::idx and Inst::raddr/waddr etc. are uint64_t
 #include "parser.hpp"  // parseTrace(...), parseOperand(...)
+#include "semantics.hpp"  // opcode descriptor table
 
 // Global instruction list
 list<Inst> instlist;
 
 /*
- * A set of instructions that do NOT affect data dependencies,
- * so we skip them when building parameters.
+ * Per-form parameter builders, indexed by SemForm (see semantics.hpp).
+ *
+ * Each one uses operand info (op0->ty, op0->field[0], etc.) plus
+ * read/write addresses (raddr/waddr) to figure out what's being
+ * read/written, and returns 1 for an operand shape it cannot model.
  */
-set<string> skipinst = {
-    "test","jmp","jz","jbe","jo","jno","js","jns","je","jne",
-    "jnz","jb","jnae","jc","jnb","jae","jnc","jna","ja","jnbe","jl",
-    "jnge","jge","jnl","jle","jng","jg","jnle","jp","jpe","jnp","jpo",
-    "jcxz","jecxz","ret","cmp","call"
+typedef int (*ParamRule)(Inst &ins);
+
+// Memory access size of an operand, 'dflt' bytes when the size is unknown
+static int memBytes(const Operand *op, int dflt)
+{
+    int nbyte = op->bit / 8;
+    return nbyte > 0 ? nbyte : dflt;
+}
+
+static int paramNoEffect(Inst &)
+{
+    return 0;
+}
+
+static int paramPush(Inst &ins)
+{
+    Operand *op0 = ins.oprd[0];
+
+    // On a 64-bit system, pushing is 8 bytes
+    if (op0->ty == OperandType::IMM) {
+        ins.addsrc(Parameter::IMM, op0->field[0]);
+        ins.adddst(Parameter::MEM, AddrRange(ins.waddr, ins.waddr + 7));
+    }
+    else if (op0->ty == OperandType::REG) {
+        ins.addsrc(Parameter::REG, op0->field[0]);
+        ins.adddst(Parameter::MEM, AddrRange(ins.waddr, ins.waddr + 7));
+    }
+    else if (op0->ty == OperandType::MEM) {
+        int nbyte = memBytes(op0, 8);
+        ins.addsrc(Parameter::MEM, AddrRange(ins.raddr, ins.raddr + nbyte - 1));
+        ins.adddst(Parameter::MEM, AddrRange(ins.waddr, ins.waddr + nbyte - 1));
+    }
+    else {
+        cerr << "[push error] Unknown operand type for op0!\n";
+        return 1;
+    }
+    return 0;
+}
+
+static int paramPop(Inst &ins)
+{
+    Operand *op0 = ins.oprd[0];
+
+    // On 64-bit, pop also fetches 8 bytes
+    AddrRange rar(ins.raddr, ins.raddr + 7);
+    if (op0->ty == OperandType::REG) {
+        ins.addsrc(Parameter::MEM, rar);
+        ins.adddst(Parameter::REG, op0->field[0]);
+    }
+    else if (op0->ty == OperandType::MEM) {
+        ins.addsrc(Parameter::MEM, rar);
+        ins.adddst(Parameter::MEM, AddrRange(ins.waddr, ins.waddr + 7));
+    }
+    else {
+        cerr << "[pop error] op0 is not REG or MEM!\n";
+        return 1;
+    }
+    return 0;
+}
+
+static int paramMov(Inst &ins)
+{
+    Operand *op0 = ins.oprd[0];
+    Operand *op1 = ins.oprd[1];
+
+    if (op0->ty == OperandType::REG) {
+        if (op1->ty == OperandType::IMM) {
+            ins.addsrc(Parameter::IMM, op1->field[0]);
+        }
+        else if (op1->ty == OperandType::REG) {
+            ins.addsrc(Parameter::REG, op1->field[0]);
+        }
+        else if (op1->ty == OperandType::MEM) {
+            int nbyte = memBytes(op1, 8);
+            ins.addsrc(Parameter::MEM, AddrRange(ins.raddr, ins.raddr + nbyte - 1));
+        }
+        else {
+            cerr << "[mov error] op0=REG, op1 not IMM/REG/MEM\n";
+            return 1;
+        }
+        ins.adddst(Parameter::REG, op0->field[0]);
+    }
+    else if (op0->ty == OperandType::MEM) {
+        int nbyte = memBytes(op0, 8);
+        if (op1->ty == OperandType::IMM) {
+            ins.addsrc(Parameter::IMM, op1->field[0]);
+        }
+        else if (op1->ty == OperandType::REG) {
+            ins.addsrc(Parameter::REG, op1->field[0]);
+        }
+        else {
+            cerr << "[mov error] op0=MEM, op1 not IMM/REG\n";
+            return 1;
+        }
+        ins.adddst(Parameter::MEM, AddrRange(ins.waddr, ins.waddr + nbyte - 1));
+    }
+    else {
+        cerr << "[mov error] op0 is not MEM or REG\n";
+        return 1;
+    }
+    return 0;
+}
+
+static int paramLea(Inst &ins)
+{
+    Operand *op0 = ins.oprd[0];
+    Operand *op1 = ins.oprd[1];
+
+    // e.g. lea reg, [mem]
+    if (op0->ty != OperandType::REG || op1->ty != OperandType::MEM) {
+        cerr << "[lea error] op0 must be REG, op1 must be MEM\n";
+        return 0;
+    }
+    // The result depends on the registers of the address expression only;
+    // rip is a constant in a trace
+    string regs[2];
+    int n = addrRegs(op1, regs);
+    for (int i = 0; i < n; i++) {
+        if (regs[i] != "rip") ins.addsrc(Parameter::REG, regs[i]);
+    }
+    ins.adddst(Parameter::REG, op0->field[0]);
+    return 0;
+}
+
+static int paramXchg(Inst &ins)
+{
+    Operand *op0 = ins.oprd[0];
+    Operand *op1 = ins.oprd[1];
+
+    // xchg => each operand is both src and dst
+    // We'll store them as separate sets: main (src/dst) vs. second (src2/dst2)
+    if (op1->ty == OperandType::REG) {
+        ins.addsrc(Parameter::REG, op1->field[0]);
+        ins.adddst2(Parameter::REG, op1->field[0]);
+    }
+    else if (op1->ty == OperandType::MEM) {
+        int nbyte = memBytes(op1, 8);
+        AddrRange ar(ins.raddr, ins.raddr + nbyte - 1);
+        ins.addsrc(Parameter::MEM, ar);
+        ins.adddst2(Parameter::MEM, ar);
+    }
+    else {
+        cerr << "[xchg error] op1 is not REG or MEM\n";
+        return 1;
+    }
+
+    if (op0->ty == OperandType::REG) {
+        ins.addsrc2(Parameter::REG, op0->field[0]);
+        ins.adddst(Parameter::REG, op0->field[0]);
+    }
+    else if (op0->ty == OperandType::MEM) {
+        int nbyte = memBytes(op0, 8);
+        AddrRange ar(ins.raddr, ins.raddr + nbyte - 1);
+        ins.addsrc2(Parameter::MEM, ar);
+        ins.adddst(Parameter::MEM, ar);
+    }
+    else {
+        cerr << "[xchg error] op0 is not REG or MEM\n";
+        return 1;
+    }
+    return 0;
+}
+
+static int paramUnary(Inst &ins)
+{
+    Operand *op0 = ins.oprd[0];
+
+    // Single-operand instructions: inc [mem], dec reg, neg reg, etc.
+    if (op0->ty == OperandType::REG) {
+        ins.addsrc(Parameter::REG, op0->field[0]);
+        ins.adddst(Parameter::REG, op0->field[0]);
+    }
+    else if (op0->ty == OperandType::MEM) {
+        int nbyte = memBytes(op0, 8);
+        ins.addsrc(Parameter::MEM, AddrRange(ins.raddr, ins.raddr + nbyte - 1));
+        ins.adddst(Parameter::MEM, AddrRange(ins.waddr, ins.waddr + nbyte - 1));
+    }
+    else {
+        cerr << "[Error] Instruction " << ins.id
+             << ": Unknown 1-op form for " << ins.opcstr << endl;
+        return 1;
+    }
+    return 0;
+}
+
+static int paramBinary(Inst &ins)
+{
+    Operand *op0 = ins.oprd[0];
+    Operand *op1 = ins.oprd[1];
+
+    // Generic 2-operand instruction (like add, sub, and, or, etc.)
+    // 1) handle second operand as source
+    if (op1->ty == OperandType::IMM) {
+        ins.addsrc(Parameter::IMM, op1->field[0]);
+    }
+    else if (op1->ty == OperandType::REG) {
+        ins.addsrc(Parameter::REG, op1->field[0]);
+    }
+    else if (op1->ty == OperandType::MEM) {
+        int nbyte = memBytes(op1, 8);
+        ins.addsrc(Parameter::MEM, AddrRange(ins.raddr, ins.raddr + nbyte - 1));
+    }
+    else {
+        cerr << "[2-op error] op1 not IMM/REG/MEM\n";
+        return 1;
+    }
+
+    // 2) handle first operand as source+dest
+    if (op0->ty == OperandType::REG) {
+        ins.addsrc(Parameter::REG, op0->field[0]);
+        ins.adddst(Parameter::REG, op0->field[0]);
+    }
+    else if (op0->ty == OperandType::MEM) {
+        int nbyte = memBytes(op0, 8);
+        AddrRange rar(ins.raddr, ins.raddr + nbyte - 1);
+        ins.addsrc(Parameter::MEM, rar);
+        ins.adddst(Parameter::MEM, rar);
+    }
+    else {
+        cerr << "[2-op error] op0 not REG or MEM\n";
+        return 1;
+    }
+    return 0;
+}
+
+static int paramTernary(Inst &ins)
+{
+    // Example: imul reg, reg/mem, imm (op0 is written, not read)
+    Operand *op0 = ins.oprd[0];
+    Operand *op1 = ins.oprd[1];
+    Operand *op2 = ins.oprd[2];
+
+    if (op0->ty != OperandType::REG || op2->ty != OperandType::IMM) {
+        cerr << "[3-op error] unrecognized pattern, e.g. 'imul reg, reg, imm'\n";
+        return 1;
+    }
+    ins.addsrc(Parameter::IMM, op2->field[0]);
+    if (op1->ty == OperandType::REG) {
+        ins.addsrc(Parameter::REG, op1->field[0]);
+    }
+    else if (op1->ty == OperandType::MEM) {
+        int nbyte = memBytes(op1, 8);
+        ins.addsrc(Parameter::MEM, AddrRange(ins.raddr, ins.raddr + nbyte - 1));
+    }
+    else {
+        cerr << "[3-op error] op1 not REG or MEM\n";
+        return 1;
+    }
+    ins.adddst(Parameter::REG, op0->field[0]);
+    return 0;
+}
+
+static int paramVBinary(Inst &ins)
+{
+    // vpaddd dst, src1, src2 [, mask]
+    Operand *op0 = ins.oprd[0];
+    Operand *op1 = ins.oprd[1];
+    Operand *op2 = ins.oprd[2];
+
+    if (ins.oprnum < 3 || op0->ty != OperandType::REG ||
+        op1->ty != OperandType::REG || op2->ty != OperandType::REG) {
+        cerr << "[" << ins.opcstr << " error] Invalid operand types\n";
+        return 1;
+    }
+    ins.addsrc(Parameter::REG, op1->field[0]);
+    ins.addsrc(Parameter::REG, op2->field[0]);
+    ins.adddst(Parameter::REG, op0->field[0]);
+    return 0;
+}
+
+static int paramVLoad(Inst &ins)
+{
+    // vmovdqu32 dst, [mem] [, ...]
+    Operand *op0 = ins.oprd[0];
+    Operand *op1 = ins.oprd[1];
+
+    if (ins.oprnum < 2 || op0->ty != OperandType::REG || op1->ty != OperandType::MEM) {
+        cerr << "[" << ins.opcstr << " error] Invalid operand types\n";
+        return 1;
+    }
+    // Default to 32 bytes for 256-bit registers
+    int nbyte = memBytes(op1, 32);
+    ins.addsrc(Parameter::MEM, AddrRange(ins.raddr, ins.raddr + nbyte - 1));
+    ins.adddst(Parameter::REG, op0->field[0]);
+    return 0;
+}
+
+static int paramUnknown(Inst &ins)
+{
+    cerr << "[error] instruction " << ins.id << " (" << ins.opcstr << ") has "
+         << ins.oprnum << " operands in an unknown form\n";
+    return 1;
+}
+
+static const ParamRule paramRules[(int)SemForm::COUNT] = {
+    paramNoEffect,  // NOEFFECT
+    paramPush,      // PUSH
+    paramPop,       // POP
+    paramMov,       // MOV
+    paramLea,       // LEA
+    paramXchg,      // XCHG
+    paramUnary,     // UNARY
+    paramBinary,    // BINARY
+    paramTernary,   // TERNARY
+    paramVBinary,   // VBINARY
+    paramVLoad,     // VLOAD
+    paramUnknown,   // UNKNOWN
+};
+
+/*
+ * Build fine-grained parameters (src/dst) for one instruction.
+ */
+int buildParameter(Inst &ins)
+{
+    return paramRules[(int)opDesc(ins)->form](ins);
+}
+
+/*
+ * Build fine-grained parameters (src/dst) for each instruction in L.
+ */
+int buildParameter(list<Inst> &L)
+{
+    for (auto &ins : L) {
+        if (buildParameter(ins) != 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Print one instruction along with its src/dst parameters.
+ */
+void printInstParameter(const Inst &ins)
+{
+    cout << ins.id << " " << ins.addr << " " << ins.assembly << "\t";
+    cout << "src: ";
+
+    // Print src parameters
+    for (auto &p : ins.src) {
+        if (p.ty == Parameter::IMM) {
+            cout << "(IMM 0x" << std::hex << p.idx << std::dec << ") ";
+        }
+        else if (p.ty == Parameter::REG) {
+            cout << "(REG " << reg2string(p.reg) << p.idx << ") ";
+        }
+        else if (p.ty == Parameter::MEM) {
+            cout << "(MEM 0x" << std::hex << p.idx << std::dec << ") ";
+        }
+        else {
+            cout << "[Error] Unknown src Parameter type! ";
+        }
+    }
+
+    cout << ", dst: ";
+    for (auto &p : ins.dst) {
+        if (p.ty == Parameter::IMM) {
+            cout << "(IMM 0x" << std::hex << p.idx << std::dec << ") ";
+        }
+        else if (p.ty == Parameter::REG) {
+            cout << "(REG " << reg2string(p.reg) << p.idx << ") ";
+        }
+        else if (p.ty == Parameter::MEM) {
+            cout << "(MEM 0x" << std::hex << p.idx << std::dec << ") ";
+        }
+        else {
+            cout << "[Error] Unknown dst Parameter type! ";
+        }
+    }
+    cout << endl;
+}
+
+/*
+ * Print the instructions in L along with their src/dst parameters.
+ */
+void printInstParameter(list<Inst> &L)
+{
+    for (auto &ins : L) {
+        printInstParameter(ins);
+    }
+}
+
+/*
+ * Print only the instructions of L whose id is in 'ids' (sorted ascending).
+ */
+void printInstParameter(list<Inst> &L, const vector<int> &ids)
+{
+    auto idit = ids.begin();
+    for (auto it = L.begin(); it != L.end() && idit != ids.end(); ++it) {
+        while (idit != ids.end() && *idit < it->id) ++idit;
+        if (idit != ids.end() && *idit == it->id) {
+            printInstParameter(*it);
+            ++idit;
+        }
+    }
+}
+
+/*
+ * A slicing criterion: the value of 'loc' as read by instruction 'id'.
+ * With 'allsrc' set, every source of that instruction is the criterion.
+ */
+struct SliceCriterion {
+    int id;
+    bool allsrc;
+    vector<Parameter> loc;
+};
+
+// One bit per criterion; a single reverse walk serves up to 64 criteria
+typedef uint64_t CritMask;
+static const int MAXCRIT = 64;
+
+/*
+ * Read slicing criteria from a file, one per line:
+ *   <id> *                   all sources of instruction <id>
+ *   <id> <reg>               register, e.g. rax or ecx
+ *   <id> mem:<addr>:<nbyte>  memory range, address in hex
+ * Empty lines and lines starting with '#' are ignored.
+ */
+int parseCriteria(ifstream *infile, vector<SliceCriterion> &crit)
+{
+    string line;
+    while (getline(*infile, line)) {
+        if (line.empty() || line[0] == '#') continue;
+
+        istringstream strbuf(line);
+        SliceCriterion c;
+        string loc;
+        if (!(strbuf >> c.id >> loc)) {
+            cerr << "[criteria error] cannot parse line: " << line << endl;
+            return 1;
+        }
+        c.allsrc = (loc == "*");
+
+        // Let Inst's helpers expand the location into byte-sized Parameters
+        Inst tmp;
+        if (loc.compare(0, 4, "mem:") == 0) {
+            size_t sep = loc.find(':', 4);
+            if (sep == string::npos) {
+                cerr << "[criteria error] expected mem:<addr>:<nbyte>: " << line << endl;
+                return 1;
+            }
+            ADDR64 addr;
+            int nbyte;
+            try {
+                addr = stoull(loc.substr(4, sep - 4), nullptr, 16);
+                nbyte = stoi(loc.substr(sep + 1));
+            }
+            catch (const logic_error &) {   // invalid_argument, out_of_range
+                cerr << "[criteria error] bad address or size: " << line << endl;
+                return 1;
+            }
+            if (nbyte < 1) {
+                cerr << "[criteria error] size must be at least 1 byte: " << line << endl;
+                return 1;
+            }
+            tmp.addsrc(Parameter::MEM, AddrRange(addr, addr + nbyte - 1));
+        }
+        else if (!c.allsrc) {
+            tmp.addsrc(Parameter::REG, loc);
+        }
+        if (!c.allsrc && tmp.src.empty()) {
+            cerr << "[criteria error] unknown location: " << line << endl;
+            return 1;
+        }
+        c.loc = tmp.src;
+        crit.push_back(c);
+    }
+    return 0;
+}
+
+/*
+ * One backward step over instruction 'ins': kill the worklist entries it
+ * defines and add its sources on behalf of the criteria that needed them.
+ * dst is computed from src, dst2 from src2 (only xchg fills the second
+ * pair). Returns the criteria whose slice contains 'ins'.
+ */
+CritMask sliceStep(const Inst &ins, map<Parameter, CritMask> &wl)
+{
+    CritMask depMain = 0, depSecond = 0;
+    if (wl.empty() || (ins.dst.empty() && ins.dst2.empty())) {
+        return 0;
+    }
+
+    for (auto &dstParam : ins.dst) {
+        auto found = wl.find(dstParam);
+        if (found != wl.end()) {
+            depMain |= found->second;
+            wl.erase(found);
+        }
+    }
+    for (auto &dstParam2 : ins.dst2) {
+        auto found2 = wl.find(dstParam2);
+        if (found2 != wl.end()) {
+            depSecond |= found2->second;
+            wl.erase(found2);
+        }
+    }
+
+    // Insert non-IMM sources of the dependent pair(s) into the worklist
+    if (depMain) {
+        for (auto &srcParam : ins.src) {
+            if (srcParam.ty != Parameter::IMM) {
+                wl[srcParam] |= depMain;
+            }
+        }
+    }
+    if (depSecond) {
+        for (auto &src2Param : ins.src2) {
+            if (src2Param.ty != Parameter::IMM) {
+                wl[src2Param] |= depSecond;
+            }
+        }
+    }
+    return depMain | depSecond;
+}
+
+/*
+ * Seed criterion 'bit' at instruction 'ins' into the worklist.
+ */
+static void seedCriterion(const Inst &ins, const SliceCriterion &c,
+                          CritMask bit, map<Parameter, CritMask> &wl)
+{
+    if (!c.allsrc) {
+        for (auto &p : c.loc) wl[p] |= bit;
+        return;
+    }
+    for (auto &p : ins.src) {
+        if (p.ty != Parameter::IMM) wl[p] |= bit;
+    }
+    for (auto &p : ins.src2) {
+        if (p.ty != Parameter::IMM) wl[p] |= bit;
+    }
+}
+
+/*
+ * Backward-slice L for every criterion in 'crit'. Each worklist location
+ * carries a bitmask of the criteria that still need its definition, so
+ * MAXCRIT criteria share one reverse walk; larger sets take one walk per
+ * batch of MAXCRIT. The criterion instruction itself heads its slice.
+ *
+ * slices[i] receives the ascending instruction IDs for crit[i]; locations
+ * still undefined at the start of the trace are left in 'leftover'.
+ */
+void multislice(list<Inst> &L, const vector<SliceCriterion> &crit,
+                vector<vector<int>> &slices, map<Parameter, CritMask> *leftover)
+{
+    slices.assign(crit.size(), vector<int>());
+
+    for (size_t base = 0; base < crit.size(); base += MAXCRIT) {
+        size_t n = min(crit.size() - base, (size_t)MAXCRIT);
+
+        // Visit this batch's criteria in reverse trace order
+        vector<size_t> order(n);
+        for (size_t i = 0; i < n; ++i) order[i] = base + i;
+        sort(order.begin(), order.end(), [&](size_t x, size_t y) {
+            return crit[x].id > crit[y].id;
+        });
+
+        map<Parameter, CritMask> wl;
+        size_t next = 0;
+        for (auto rit = L.rbegin(); rit != L.rend(); ++rit) {
+            // Nothing left to look for: the rest of the trace is irrelevant
+            if (next == n && wl.empty()) break;
+            if (wl.empty() && rit->id > crit[order[next]].id) continue;
+
+            CritMask dep = sliceStep(*rit, wl);
+            for (size_t i = 0; dep != 0; ++i, dep >>= 1) {
+                if (dep & 1) slices[base + i].push_back(rit->id);
+            }
+
+            for (; next < n && crit[order[next]].id >= rit->id; ++next) {
+                size_t c = order[next];
+                if (crit[c].id != rit->id) {
+                    cerr << "[multislice] criterion instruction " << crit[c].id
+                         << " not in trace\n";
+                    continue;
+                }
+                seedCriterion(*rit, crit[c], (CritMask)1 << (c - base), wl);
+                slices[c].push_back(rit->id);
+            }
+        }
+        for (; next < n; ++next) {
+            cerr << "[multislice] criterion instruction " << crit[order[next]].id
+                 << " not in trace\n";
+        }
+
+        if (leftover) {
+            for (auto &kv : wl) (*leftover)[kv.first] |= kv.second;
+        }
+    }
+
+    for (auto &sl : slices) {
+        std::reverse(sl.begin(), sl.end());
+    }
+}
+
+// Fold repeated iterations in slice output (-z)
+bool foldslice = false;
+
+/*
+ * Write a slice to <prefix>.human.trace and <prefix>.llse.trace, folding
+ * repeated instruction sequences if requested.
+ */
+static void writeSlice(list<Inst> &L, const vector<int> &ids, const string &prefix)
+{
+    if (foldslice) {
+        printTraceFoldedHuman(L, ids, prefix + ".human.trace");
+        printTraceFoldedLLSE(L, ids, prefix + ".llse.trace");
+    } else {
+        printTraceHuman(L, ids, prefix + ".human.trace");
+        printTraceLLSE(L, ids, prefix + ".llse.trace");
+    }
+}
+
+/*
+ * Perform a backward slice on the instruction list L,
+ * starting from the last instruction's src parameters.
+ *
+ * The slice is kept as the ascending list of instruction IDs; the
+ * instructions themselves are never copied, the printers below read
+ * them straight from L.
+ */
+int backslice(list<Inst> &L)
+{
+    // Start from the last instruction
+    if (L.empty()) {
+        cout << "[backslice] No instructions in list!\n";
+        return 0;
+    }
+    SliceCriterion last;
+    last.id = L.back().id;
+    last.allsrc = true;
+
+    vector<vector<int>> slices;
+    map<Parameter, CritMask> wl;
+    multislice(L, vector<SliceCriterion>(1, last), slices, &wl);
+    vector<int> &sl = slices[0];
+
+    // Print any leftover parameters in the working list
+    if (!wl.empty()) {
+        cout << "\n[backslice] Leftover parameters in WL:\n";
+        for (auto &kv : wl) {
+            kv.first.show();
+        }
+        cout << endl;
+    }
+
+    // Print the sliced instructions
+    cout << "\n[backslice] Final Sliced Instructions:\n";
+    printInstParameter(L, sl);
+
+    // Write the slices out to separate files in your custom format
+    writeSlice(L, sl, "slice");
+
+    return 0;
+}
+
+/*
+ * Slice L for every criterion in 'crit' in a shared pass and write
+ * slice<N>.human.trace / slice<N>.llse.trace for the N-th criterion.
+ */
+int backslice(list<Inst> &L, const vector<SliceCriterion> &crit)
+{
+    vector<vector<int>> slices;
+    multislice(L, crit, slices, nullptr);
+
+    for (size_t i = 0; i < slices.size(); ++i) {
+        string n = to_string(i + 1);
+        cout << "[backslice] criterion " << n << " (instruction " << crit[i].id
+             << "): " << slices[i].size() << " instructions\n";
+        writeSlice(L, slices[i], "slice" + n);
+    }
+    return 0;
+}
+
+/*
+ * A trace region [begin, end] of instruction IDs, both inclusive, as
+ * vmextract writes them to vmregions.txt: one "<begin> <end>" per line.
+ */
+struct Region {
+    int begin;
+    int end;
+};
+
+int parseRegions(ifstream *infile, vector<Region> &regions)
+{
+    string line;
+    while (getline(*infile, line)) {
+        if (line.empty() || line[0] == '#') continue;
+
+        istringstream strbuf(line);
+        Region r;
+        if (!(strbuf >> r.begin >> r.end) || r.end < r.begin) {
+            cerr << "[regions error] cannot parse line: " << line << endl;
+            return 1;
+        }
+        regions.push_back(r);
+    }
+    return 0;
+}
+
+/*
+ * Run work(task, thread) for every task in [0, ntask) on nthread threads.
+ *
+ * Each thread owns a deque seeded with a contiguous block of tasks. It
+ * takes work from the back of its own deque and, once that is empty,
+ * steals from the front of the others, so a few long tasks do not leave
+ * the remaining threads idle. Each deque has its own lock; outside of
+ * stealing only its owner takes it.
+ */
+struct WorkDeque {
+    mutex lock;
+    deque<size_t> tasks;
+};
+
+static bool takeTask(WorkDeque &wq, bool steal, size_t &task)
+{
+    lock_guard<mutex> guard(wq.lock);
+    if (wq.tasks.empty()) return false;
+    if (steal) {
+        task = wq.tasks.front();
+        wq.tasks.pop_front();
+    } else {
+        task = wq.tasks.back();
+        wq.tasks.pop_back();
+    }
+    return true;
+}
+
+void runPool(size_t ntask, int nthread, const function<void(size_t, int)> &work)
+{
+    if (nthread < 1) nthread = 1;
+    if ((size_t)nthread > ntask) nthread = (int)max(ntask, (size_t)1);
+
+    vector<WorkDeque> queues(nthread);
+    for (int t = 0; t < nthread; ++t) {
+        size_t lo = ntask * t / nthread, hi = ntask * (t + 1) / nthread;
+        // Pushed in reverse so the owner runs its block in trace order
+        for (size_t i = hi; i-- > lo; ) queues[t].tasks.push_back(i);
+    }
+
+    auto worker = [&](int self) {
+        size_t task;
+        for (;;) {
+            bool found = takeTask(queues[self], false, task);
+            for (int k = 1; !found && k < nthread; ++k) {
+                found = takeTask(queues[(self + k) % nthread], true, task);
+            }
+            // Tasks never spawn tasks: all deques empty means done
+            if (!found) return;
+            work(task, self);
+        }
+    };
+
+    vector<thread> threads;
+    for (int t = 1; t < nthread; ++t) threads.emplace_back(worker, t);
+    worker(0);
+    for (auto &th : threads) th.join();
+}
+
+/*
+ * Backward-slice one region from all sources of its last instruction,
+ * looking no further back than the region's first instruction. 'trace'
+ * holds L in order, so the region is located by binary search on id.
+ */
+static void sliceRegion(const vector<const Inst *> &trace, const Region &r,
+                        vector<int> &out)
+{
+    auto byId = [](const Inst *ins, int id) { return ins->id < id; };
+    size_t lo = lower_bound(trace.begin(), trace.end(), r.begin, byId) - trace.begin();
+    size_t hi = lower_bound(trace.begin(), trace.end(), r.end + 1, byId) - trace.begin();
+    if (lo >= hi) return;
+
+    SliceCriterion last;
+    last.id = trace[hi - 1]->id;
+    last.allsrc = true;
+
+    map<Parameter, CritMask> wl;
+    seedCriterion(*trace[hi - 1], last, 1, wl);
+    out.push_back(last.id);
+    for (size_t i = hi - 1; i-- > lo && !wl.empty(); ) {
+        if (sliceStep(*trace[i], wl)) out.push_back(trace[i]->id);
+    }
+    std::reverse(out.begin(), out.end());
+}
+
+/*
+ * Slice every region independently on 'nthread' threads and write
+ * region<N>.llse.trace for the N-th one. Workers keep their own worklist
+ * and write their own files; the only shared state is the read-only
+ * trace and the per-region result slot.
+ */
+int sliceRegions(list<Inst> &L, const vector<Region> &regions, int nthread)
+{
+    vector<const Inst *> trace;
+    trace.reserve(L.size());
+    for (auto &ins : L) trace.push_back(&ins);
+
+    // Map an id back to its Inst for output
+    auto lookup = [&](int id) {
+        return *lower_bound(trace.begin(), trace.end(), id,
+                            [](const Inst *ins, int v) { return ins->id < v; });
+    };
+
+    vector<vector<int>> slices(regions.size());
+    runPool(regions.size(), nthread, [&](size_t r, int) {
+        sliceRegion(trace, regions[r], slices[r]);
+
+        string fname = "region" + to_string(r + 1) + ".llse.trace";
+        FILE *fp = fopen(fname.c_str(), "w");
+        if (!fp) {
+            cerr << "[regions] Failed to open " << fname << endl;
+            return;
+        }
+        for (int id : slices[r]) printInstLLSE(fp, *lookup(id));
+        fclose(fp);
+    });
+
+    for (size_t r = 0; r < regions.size(); ++r) {
+        cout << "[regions] region " << r + 1 << " (" << regions[r].begin << "-"
+             << regions[r].end << "): " << slices[r].size() << " instructions\n";
+    }
+    return 0;
+}
+
+/*
+ * Hash for Parameter, consistent with Parameter::operator== (the register
+ * only matters for REG parameters).
+ */
+struct ParameterHash {
+    size_t operator()(const Parameter &p) const {
+        uint64_t k = p.idx * 0x9e3779b97f4a7c15ULL;
+        if (p.ty == Parameter::REG) k ^= ((uint64_t)p.reg + 1) << 56;
+        return (size_t)(k ^ ((uint64_t)p.ty << 62) ^ (k >> 29));
+    }
 };
 
 /*
- * Build fine-grained parameters (src/dst) for each instruction in L.
- * 
- * This uses operand info (op0->ty, op0->field[0], etc.) plus
- * read/write addresses (raddr/waddr) to figure out what's being read/written.
+ * Dynamic data-dependence graph over a trace. Node k is the k-th
+ * instruction of the trace (ids[k] is its Inst::id); its dependences are
+ * the nodes that last defined one of its source locations, stored in CSR
+ * form: dep[off[k] .. off[k+1]). The reverse graph (users of each node)
+ * is built on the first forward query.
+ *
+ * Dependences are per instruction, so an xchg node depends on the
+ * definers of both of its operands.
+ */
+struct DepGraph {
+    vector<int> ids;
+    vector<uint64_t> off;
+    vector<uint32_t> dep;
+    vector<uint64_t> roff;
+    vector<uint32_t> rdep;
+    vector<uint8_t> mark;     // scratch for traversals, always left cleared
+};
+
+/*
+ * Build the graph in one forward pass over the parameters built by
+ * buildParameter, tracking the last definer of every location.
+ */
+void buildDepGraph(list<Inst> &L, DepGraph &g)
+{
+    unordered_map<Parameter, uint32_t, ParameterHash> lastdef;
+    vector<uint32_t> deps;
+
+    g.ids.clear();
+    g.dep.clear();
+    g.off.assign(1, 0);
+    uint32_t k = 0;
+    for (auto &ins : L) {
+        deps.clear();
+        for (auto *srcs : { &ins.src, &ins.src2 }) {
+            for (auto &p : *srcs) {
+                if (p.ty == Parameter::IMM) continue;
+                auto found = lastdef.find(p);
+                if (found != lastdef.end()) deps.push_back(found->second);
+            }
+        }
+        sort(deps.begin(), deps.end());
+        deps.erase(unique(deps.begin(), deps.end()), deps.end());
+        g.dep.insert(g.dep.end(), deps.begin(), deps.end());
+        g.off.push_back(g.dep.size());
+        g.ids.push_back(ins.id);
+
+        for (auto *dsts : { &ins.dst, &ins.dst2 }) {
+            for (auto &p : *dsts) lastdef[p] = k;
+        }
+        ++k;
+    }
+    g.roff.clear();
+    g.rdep.clear();
+    g.mark.assign(g.ids.size(), 0);
+}
+
+/*
+ * On-disk format: the 8-byte magic "VMDDG01\0", node and edge counts as
+ * two little-endian uint64, then per node the varint id delta, the varint
+ * dependence count and each dependence as a varint distance back from the
+ * node. Definitions are usually recent, so most edges take one byte.
+ */
+static const char DDG_MAGIC[8] = { 'V','M','D','D','G','0','1','\0' };
+
+static void putVarint(vector<uint8_t> &buf, uint64_t v)
+{
+    while (v >= 0x80) {
+        buf.push_back((uint8_t)(v | 0x80));
+        v >>= 7;
+    }
+    buf.push_back((uint8_t)v);
+}
+
+static bool getVarint(const vector<uint8_t> &buf, size_t &pos, uint64_t &v)
+{
+    v = 0;
+    for (int shift = 0; pos < buf.size() && shift < 64; shift += 7) {
+        uint8_t b = buf[pos++];
+        v |= (uint64_t)(b & 0x7f) << shift;
+        if (!(b & 0x80)) return true;
+    }
+    return false;
+}
+
+int saveDepGraph(const DepGraph &g, string fname)
+{
+    FILE *fp = fopen(fname.c_str(), "wb");
+    if (!fp) {
+        cerr << "[saveDepGraph] Cannot open " << fname << "\n";
+        return 1;
+    }
+    uint64_t hdr[2] = { g.ids.size(), g.dep.size() };
+    bool ok = fwrite(DDG_MAGIC, 1, sizeof(DDG_MAGIC), fp) == sizeof(DDG_MAGIC)
+           && fwrite(hdr, sizeof(uint64_t), 2, fp) == 2;
+
+    vector<uint8_t> buf;
+    int previd = 0;
+    for (size_t k = 0; ok && k < g.ids.size(); ++k) {
+        putVarint(buf, (uint64_t)(g.ids[k] - previd));
+        previd = g.ids[k];
+        putVarint(buf, g.off[k + 1] - g.off[k]);
+        for (uint64_t e = g.off[k]; e < g.off[k + 1]; ++e) {
+            putVarint(buf, k - g.dep[e]);
+        }
+        if (buf.size() >= (1 << 20)) {
+            ok = fwrite(buf.data(), 1, buf.size(), fp) == buf.size();
+            buf.clear();
+        }
+    }
+    ok = ok && fwrite(buf.data(), 1, buf.size(), fp) == buf.size();
+    if (fclose(fp) != 0) ok = false;
+    if (!ok) {
+        cerr << "[saveDepGraph] Write to " << fname << " failed\n";
+        return 1;
+    }
+    return 0;
+}
+
+int loadDepGraph(string fname, DepGraph &g)
+{
+    ifstream in(fname, ios::binary);
+    if (!in.is_open()) {
+        cerr << "[loadDepGraph] Cannot open " << fname << "\n";
+        return 1;
+    }
+    char magic[8];
+    uint64_t hdr[2];
+    in.read(magic, sizeof(magic));
+    in.read((char *)hdr, sizeof(hdr));
+    if (!in || memcmp(magic, DDG_MAGIC, sizeof(magic)) != 0) {
+        cerr << "[loadDepGraph] " << fname << " is not a dependence graph\n";
+        return 1;
+    }
+    vector<uint8_t> buf((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+    size_t pos = 0;
+    uint64_t e = 0, v, cnt;
+    int previd = 0;
+
+    // Every node takes at least two bytes and every edge one; reject
+    // counts the payload cannot hold before allocating for them
+    if (hdr[0] > buf.size() / 2 || hdr[1] > buf.size() - 2 * hdr[0]) goto truncated;
+
+    g.ids.resize(hdr[0]);
+    g.off.resize(hdr[0] + 1);
+    g.dep.resize(hdr[1]);
+    g.off[0] = 0;
+    for (uint64_t k = 0; k < hdr[0]; ++k) {
+        if (!getVarint(buf, pos, v)) goto truncated;
+        previd += (int)v;
+        g.ids[k] = previd;
+        if (!getVarint(buf, pos, cnt) || e + cnt > hdr[1]) goto truncated;
+        for (uint64_t i = 0; i < cnt; ++i, ++e) {
+            if (!getVarint(buf, pos, v) || v == 0 || v > k) goto truncated;
+            g.dep[e] = (uint32_t)(k - v);
+        }
+        g.off[k + 1] = e;
+    }
+    if (e != hdr[1]) goto truncated;
+    g.roff.clear();
+    g.rdep.clear();
+    g.mark.assign(g.ids.size(), 0);
+    return 0;
+
+truncated:
+    cerr << "[loadDepGraph] " << fname << " is truncated or corrupt\n";
+    return 1;
+}
+
+/*
+ * Build the reverse graph: rdep[roff[k] .. roff[k+1]) are the users of k.
  */
-int buildParameter(list<Inst> &L)
+static void buildReverse(DepGraph &g)
 {
-    for (auto &ins : L) {
-        // If the opcode is in skipinst, do nothing for it
-        if (skipinst.find(ins.opcstr) != skipinst.end()) {
-            continue;
+    size_t n = g.ids.size();
+    g.roff.assign(n + 1, 0);
+    for (uint32_t d : g.dep) g.roff[d + 1]++;
+    for (size_t k = 0; k < n; ++k) g.roff[k + 1] += g.roff[k];
+    g.rdep.resize(g.dep.size());
+    vector<uint64_t> fill(g.roff.begin(), g.roff.end() - 1);
+    for (size_t k = 0; k < n; ++k) {
+        for (uint64_t e = g.off[k]; e < g.off[k + 1]; ++e) {
+            g.rdep[fill[g.dep[e]]++] = (uint32_t)k;
         }
+    }
+}
 
-        switch (ins.oprnum) {
-        case 0:
-            // No operands => nothing to do
-            break;
+/*
+ * Backward (or forward) slice from the instructions in 'from' by graph
+ * traversal; the cost is proportional to the slice, not the trace.
+ * 'out' receives the ascending instruction IDs.
+ */
+void graphSlice(DepGraph &g, const vector<int> &from, bool forward, vector<int> &out)
+{
+    if (forward && g.roff.empty()) buildReverse(g);
+    const vector<uint64_t> &off = forward ? g.roff : g.off;
+    const vector<uint32_t> &adj = forward ? g.rdep : g.dep;
 
-        case 1:
-        {
-            Operand *op0 = ins.oprd[0];
-            int nbyte = 0;
-
-            if (ins.opcstr == "push") {
-                // On a 64-bit system, pushing is 8 bytes
-                nbyte = (op0->bit / 8 > 0) ? (op0->bit / 8) : 8;  
-                // But if it's truly 64-bit push, override to 8 if needed
-                nbyte = 8;  
-
-                if (op0->ty == OperandType::IMM) {
-                    ins.addsrc(Parameter::IMM, op0->field[0]);
-                    AddrRange ar(ins.waddr, ins.waddr + nbyte - 1);
-                    ins.adddst(Parameter::MEM, ar);
-                }
-                else if (op0->ty == OperandType::REG) {
-                    ins.addsrc(Parameter::REG, op0->field[0]);
-                    AddrRange ar(ins.waddr, ins.waddr + nbyte - 1);
-                    ins.adddst(Parameter::MEM, ar);
-                }
-                else if (op0->ty == OperandType::MEM) {
-                    nbyte = op0->bit / 8;
-                    if (nbyte == 0) nbyte = 8;  // fallback
-                    AddrRange rar(ins.raddr, ins.raddr + nbyte - 1);
-                    ins.addsrc(Parameter::MEM, rar);
-
-                    AddrRange war(ins.waddr, ins.waddr + nbyte - 1);
-                    ins.adddst(Parameter::MEM, war);
-                }
-                else {
-                    cerr << "[push error] Unknown operand type for op0!\n";
-                    return 1;
-                }
-            }
-            else if (ins.opcstr == "pop") {
-                // On 64-bit, pop also fetches 8 bytes
-                nbyte = (op0->bit / 8 > 0) ? (op0->bit / 8) : 8;  
-                nbyte = 8;  
-
-                if (op0->ty == OperandType::REG) {
-                    AddrRange rar(ins.raddr, ins.raddr + nbyte - 1);
-                    ins.addsrc(Parameter::MEM, rar);
-                    ins.adddst(Parameter::REG, op0->field[0]);
-                }
-                else if (op0->ty == OperandType::MEM) {
-                    AddrRange rar(ins.raddr, ins.raddr + nbyte - 1);
-                    ins.addsrc(Parameter::MEM, rar);
-                    AddrRange war(ins.waddr, ins.waddr + nbyte - 1);
-                    ins.adddst(Parameter::MEM, war);
-                }
-                else {
-                    cerr << "[pop error] op0 is not REG or MEM!\n";
-                    return 1;
-                }
-            }
-            else {
-                // Single-operand instructions: inc [mem], dec reg, neg reg, etc.
-                if (op0->ty == OperandType::REG) {
-                    ins.addsrc(Parameter::REG, op0->field[0]);
-                    ins.adddst(Parameter::REG, op0->field[0]);
-                }
-                else if (op0->ty == OperandType::MEM) {
-                    nbyte = op0->bit / 8;
-                    if (nbyte == 0) nbyte = 8;
-                    AddrRange rar(ins.raddr, ins.raddr + nbyte - 1);
-                    ins.addsrc(Parameter::MEM, rar);
-                    AddrRange war(ins.waddr, ins.waddr + nbyte - 1);
-                    ins.adddst(Parameter::MEM, war);
-                }
-                else {
-                    cerr << "[Error] Instruction " << ins.id
-                         << ": Unknown 1-op form for " << ins.opcstr << endl;
-                    return 1;
-                }
+    vector<uint32_t> stk, seen;
+    for (int id : from) {
+        auto it = lower_bound(g.ids.begin(), g.ids.end(), id);
+        if (it == g.ids.end() || *it != id) {
+            cerr << "[graphSlice] instruction " << id << " not in graph\n";
+            continue;
+        }
+        uint32_t k = (uint32_t)(it - g.ids.begin());
+        if (!g.mark[k]) {
+            g.mark[k] = 1;
+            stk.push_back(k);
+            seen.push_back(k);
+        }
+    }
+    while (!stk.empty()) {
+        uint32_t k = stk.back();
+        stk.pop_back();
+        for (uint64_t e = off[k]; e < off[k + 1]; ++e) {
+            uint32_t d = adj[e];
+            if (!g.mark[d]) {
+                g.mark[d] = 1;
+                stk.push_back(d);
+                seen.push_back(d);
             }
-            break;
         }
+    }
 
-        case 2:
-        {
-            Operand *op0 = ins.oprd[0];
-            Operand *op1 = ins.oprd[1];
-            int nbyte = 0;
-
-            // Common instructions: mov, movzx, etc.
-            if (ins.opcstr == "mov" || ins.opcstr == "movzx") {
-                if (op0->ty == OperandType::REG) {
-                    if (op1->ty == OperandType::IMM) {
-                        ins.addsrc(Parameter::IMM, op1->field[0]);
-                        ins.adddst(Parameter::REG, op0->field[0]);
-                    }
-                    else if (op1->ty == OperandType::REG) {
-                        ins.addsrc(Parameter::REG, op1->field[0]);
-                        ins.adddst(Parameter::REG, op0->field[0]);
-                    }
-                    else if (op1->ty == OperandType::MEM) {
-                        nbyte = op1->bit / 8;
-                        if (nbyte == 0) nbyte = 8;
-                        AddrRange rar(ins.raddr, ins.raddr + nbyte - 1);
-                        ins.addsrc(Parameter::MEM, rar);
-                        ins.adddst(Parameter::REG, op0->field[0]);
-                    }
-                    else {
-                        cerr << "[mov error] op0=REG, op1 not IMM/REG/MEM\n";
-                        return 1;
-                    }
-                }
-                else if (op0->ty == OperandType::MEM) {
-                    nbyte = op0->bit / 8;
-                    if (nbyte == 0) nbyte = 8;
-
-                    if (op1->ty == OperandType::IMM) {
-                        ins.addsrc(Parameter::IMM, op1->field[0]);
-                        AddrRange war(ins.waddr, ins.waddr + nbyte - 1);
-                        ins.adddst(Parameter::MEM, war);
-                    }
-                    else if (op1->ty == OperandType::REG) {
-                        ins.addsrc(Parameter::REG, op1->field[0]);
-                        AddrRange war(ins.waddr, ins.waddr + nbyte - 1);
-                        ins.adddst(Parameter::MEM, war);
-                    }
-                    else {
-                        cerr << "[mov error] op0=MEM, op1 not IMM/REG\n";
-                        return 1;
-                    }
-                }
-                else {
-                    cerr << "[mov error] op0 is not MEM or REG\n";
-                    return 1;
-                }
-            }
-            else if (ins.opcstr == "lea") {
-                // e.g. lea reg, [mem]
-                if (op0->ty != OperandType::REG || op1->ty != OperandType::MEM) {
-                    cerr << "[lea error] op0 must be REG, op1 must be MEM\n";
-                    break;
-                }
-                // For simplicity, only handle a few tags, or handle them all if your code does
-                switch (op1->tag) {
-                case 5: // e.g. rax+rbx*2
-                    ins.addsrc(Parameter::REG, op1->field[0]); // base
-                    ins.addsrc(Parameter::REG, op1->field[1]); // index
-                    // The result goes into op0
-                    ins.adddst(Parameter::REG, op0->field[0]);
-                    break;
-                // Add other cases (tag 3,4,6,7) if needed
-                default:
-                    cerr << "[lea error] unhandled address tag: " << op1->tag << endl;
-                    break;
-                }
-            }
-            else if (ins.opcstr == "xchg") {
-                // xchg => each operand is both src and dst
-                // We'll store them as separate sets: main (src/dst) vs. second (src2/dst2)
-                if (op1->ty == OperandType::REG) {
-                    ins.addsrc(Parameter::REG, op1->field[0]);
-                    ins.adddst2(Parameter::REG, op1->field[0]);
-                }
-                else if (op1->ty == OperandType::MEM) {
-                    nbyte = op1->bit / 8;
-                    if (nbyte == 0) nbyte = 8;
-                    AddrRange ar(ins.raddr, ins.raddr + nbyte - 1);
-                    ins.addsrc(Parameter::MEM, ar);
-                    ins.adddst2(Parameter::MEM, ar);
-                }
-                else {
-                    cerr << "[xchg error] op1 is not REG or MEM\n";
-                    return 1;
-                }
+    sort(seen.begin(), seen.end());
+    out.clear();
+    for (uint32_t k : seen) {
+        out.push_back(g.ids[k]);
+        g.mark[k] = 0;
+    }
+}
 
-                if (op0->ty == OperandType::REG) {
-                    ins.addsrc2(Parameter::REG, op0->field[0]);
-                    ins.adddst(Parameter::REG, op0->field[0]);
-                }
-                else if (op0->ty == OperandType::MEM) {
-                    nbyte = op0->bit / 8;
-                    if (nbyte == 0) nbyte = 8;
-                    AddrRange ar(ins.raddr, ins.raddr + nbyte - 1);
-                    ins.addsrc2(Parameter::MEM, ar);
-                    ins.adddst(Parameter::MEM, ar);
-                }
-                else {
-                    cerr << "[xchg error] op0 is not REG or MEM\n";
-                    return 1;
-                }
-            }
-            else {
-                // Generic 2-operand instruction (like add, sub, and, or, etc.)
-                // 1) handle second operand as source
-                if (op1->ty == OperandType::IMM) {
-                    ins.addsrc(Parameter::IMM, op1->field[0]);
-                }
-                else if (op1->ty == OperandType::REG) {
-                    ins.addsrc(Parameter::REG, op1->field[0]);
-                }
-                else if (op1->ty == OperandType::MEM) {
-                    nbyte = op1->bit / 8;
-                    if (nbyte == 0) nbyte = 8;
-                    AddrRange rar1(ins.raddr, ins.raddr + nbyte - 1);
-                    ins.addsrc(Parameter::MEM, rar1);
-                }
-                else {
-                    cerr << "[2-op error] op1 not IMM/REG/MEM\n";
-                    return 1;
-                }
+/*
+ * Answer slice queries against a loaded graph, one per line:
+ *   b <id> [<id> ...]    backward slice
+ *   f <id> [<id> ...]    forward slice
+ * Each answer is the slice size followed by its instruction IDs.
+ */
+void queryDepGraph(DepGraph &g, istream &in)
+{
+    string line;
+    vector<int> from, out;
+    while (getline(in, line)) {
+        istringstream strbuf(line);
+        string cmd;
+        int id;
+        if (!(strbuf >> cmd)) continue;
+        if (cmd != "b" && cmd != "f") {
+            cerr << "[query] expected 'b <id>...' or 'f <id>...'\n";
+            continue;
+        }
+        from.clear();
+        while (strbuf >> id) from.push_back(id);
+        graphSlice(g, from, cmd == "f", out);
 
-                // 2) handle first operand as source+dest
-                if (op0->ty == OperandType::REG) {
-                    ins.addsrc(Parameter::REG, op0->field[0]);
-                    ins.adddst(Parameter::REG, op0->field[0]);
-                }
-                else if (op0->ty == OperandType::MEM) {
-                    nbyte = op0->bit / 8;
-                    if (nbyte == 0) nbyte = 8;
-                    AddrRange rar2(ins.raddr, ins.raddr + nbyte - 1);
-                    ins.addsrc(Parameter::MEM, rar2);
-                    ins.adddst(Parameter::MEM, rar2);
-                }
-                else {
-                    cerr << "[2-op error] op0 not REG or MEM\n";
-                    return 1;
-                }
-            }
-            break;
+        cout << out.size() << ":";
+        for (int x : out) cout << " " << x;
+        cout << endl;
+    }
+}
+
+/*
+ * Forward taint state: one label bit per taint source, tracked per byte of
+ * memory (shadow pages allocated on first tainted write) and per register
+ * lane as produced by buildParameter.
+ */
+typedef uint64_t TaintMask;
+static const int SHADOW_PAGE_BITS = 12;
+
+struct TaintState {
+    unordered_map<ADDR64, vector<TaintMask>> shadow;   // page -> byte tags
+    TaintMask reg[UNK + 1][8] = {};
+
+    TaintMask get(const Parameter &p) const;
+    void set(const Parameter &p, TaintMask m);
+};
+
+TaintMask TaintState::get(const Parameter &p) const
+{
+    if (p.ty == Parameter::REG) {
+        return reg[p.reg][p.idx & 7];
+    }
+    if (p.ty == Parameter::MEM) {
+        auto pg = shadow.find(p.idx >> SHADOW_PAGE_BITS);
+        if (pg == shadow.end()) return 0;
+        return pg->second[p.idx & ((1 << SHADOW_PAGE_BITS) - 1)];
+    }
+    return 0;
+}
+
+void TaintState::set(const Parameter &p, TaintMask m)
+{
+    if (p.ty == Parameter::REG) {
+        reg[p.reg][p.idx & 7] = m;
+    }
+    else if (p.ty == Parameter::MEM) {
+        auto pg = shadow.find(p.idx >> SHADOW_PAGE_BITS);
+        if (pg == shadow.end()) {
+            if (m == 0) return;     // untainted stays unallocated
+            pg = shadow.emplace(p.idx >> SHADOW_PAGE_BITS,
+                                vector<TaintMask>(1 << SHADOW_PAGE_BITS, 0)).first;
         }
+        pg->second[p.idx & ((1 << SHADOW_PAGE_BITS) - 1)] = m;
+    }
+}
 
-        case 3:
-        {
-            // Example: imul reg, reg, imm
-            Operand *op0 = ins.oprd[0];
-            Operand *op1 = ins.oprd[1];
-            Operand *op2 = ins.oprd[2];
-
-            if (ins.opcstr == "imul" &&
-                op0->ty == OperandType::REG &&
-                op1->ty == OperandType::REG &&
-                op2->ty == OperandType::IMM)
-            {
-                ins.addsrc(Parameter::IMM, op2->field[0]);
-                ins.addsrc(Parameter::REG, op1->field[0]);
-                ins.addsrc(Parameter::REG, op0->field[0]);
-                // The result presumably goes into op0->REG as well.
-                ins.adddst(Parameter::REG, op0->field[0]);
-            }
-            else {
-                cerr << "[3-op error] unrecognized pattern, e.g. 'imul reg, reg, imm'\n";
-                return 1;
-            }
+/*
+ * One forward step over 'ins': every destination takes the union of the
+ * labels of its sources (dst from src, dst2 from src2), which also clears
+ * the taint of overwritten locations. Returns the labels that reached a
+ * destination, i.e. nonzero when 'ins' is tainted.
+ */
+TaintMask taintStep(const Inst &ins, TaintState &t)
+{
+    TaintMask mMain = 0, mSecond = 0;
+    for (auto &p : ins.src) mMain |= t.get(p);
+    for (auto &p : ins.src2) mSecond |= t.get(p);
+
+    for (auto &p : ins.dst) t.set(p, mMain);
+    for (auto &p : ins.dst2) t.set(p, mSecond);
+
+    return (ins.dst.empty() ? 0 : mMain) | (ins.dst2.empty() ? 0 : mSecond);
+}
+
+/*
+ * Taint the locations of source 'c' with label 'bit' before 'ins' executes.
+ */
+static void seedTaint(const Inst &ins, const SliceCriterion &c,
+                      TaintMask bit, TaintState &t)
+{
+    if (!c.allsrc) {
+        for (auto &p : c.loc) t.set(p, t.get(p) | bit);
+        return;
+    }
+    for (auto *srcs : { &ins.src, &ins.src2 }) {
+        for (auto &p : *srcs) {
+            if (p.ty != Parameter::IMM) t.set(p, t.get(p) | bit);
+        }
+    }
+}
+
+/*
+ * Forward-propagate the taint sources in 'srcs' (one label each, at most
+ * MAXCRIT) over the trace in a single streaming pass. Only the current
+ * instruction and the shadow state are held in memory.
+ *
+ * Tainted instructions are written as they are found: their original
+ * trace lines to taint.llse.trace and "<id> <label mask>" to taint.ids.
+ */
+int forwardTaint(ifstream *infile, const vector<SliceCriterion> &srcs)
+{
+    if (srcs.size() > (size_t)MAXCRIT) {
+        cerr << "[taint] at most " << MAXCRIT << " taint sources per pass\n";
+        return 1;
+    }
+    FILE *ftrace = fopen("taint.llse.trace", "w");
+    FILE *fids = fopen("taint.ids", "w");
+    if (!ftrace || !fids) {
+        cerr << "[taint] Cannot open output files\n";
+        if (ftrace) fclose(ftrace);
+        if (fids) fclose(fids);
+        return 1;
+    }
+
+    // Visit sources in trace order
+    vector<size_t> order(srcs.size());
+    for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+    sort(order.begin(), order.end(), [&](size_t x, size_t y) {
+        return srcs[x].id < srcs[y].id;
+    });
+
+    TaintState t;
+    TraceReader reader(infile);
+    Inst ins;
+    size_t next = 0;
+    uint64_t ntainted = 0;
+    vector<uint64_t> perlabel(srcs.size(), 0);
+    int ret = 0;
+    while (reader.next(ins)) {
+        if (buildParameter(ins) != 0) {
+            releaseOperand(ins);
+            ret = 1;
             break;
         }
-        //  need to deal with 4 like vpadd and mul32 something like that
-        case 4:
-        {
-            Operand *op0 = ins.oprd[0];
-            Operand *op1 = ins.oprd[1];
-            Operand *op2 = ins.oprd[2];
-            Operand *op3 = ins.oprd[3];
-            int nbyte = 0;
-
-            if (ins.opcstr == "vpaddd") {
-                // Handle vpaddd instruction
-                if (op0->ty == OperandType::REG && op1->ty == OperandType::REG && op2->ty == OperandType::REG) {
-                    ins.addsrc(Parameter::REG, op1->field[0]);
-                    ins.addsrc(Parameter::REG, op2->field[0]);
-                    ins.adddst(Parameter::REG, op0->field[0]);
-                } else {
-                    cerr << "[vpaddd error] Invalid operand types\n";
-                    return 1;
-                }
-            } else if (ins.opcstr == "vmovdqu32") {
-                // Handle vmovdqu32 instruction
-                if (op0->ty == OperandType::REG && op1->ty == OperandType::MEM) {
-                    nbyte = op1->bit / 8;
-                    if (nbyte == 0) nbyte = 32;  // Default to 32 bytes for 256-bit registers
-                    AddrRange rar(ins.raddr, ins.raddr + nbyte - 1);
-                    ins.addsrc(Parameter::MEM, rar);
-                    ins.adddst(Parameter::REG, op0->field[0]);
-                } else {
-                    cerr << "[vmovdqu32 error] Invalid operand types\n";
-                    return 1;
-                }
-            } else {
-                cerr << "[4-op error] Unrecognized 4-op instruction\n";
-                return 1;
+        for (; next < order.size() && srcs[order[next]].id <= ins.id; ++next) {
+            size_t c = order[next];
+            if (srcs[c].id == ins.id) {
+                seedTaint(ins, srcs[c], (TaintMask)1 << c, t);
             }
-            break;
         }
-        default:
-            cerr << "[error] instruction has " << ins.oprnum 
-                 << " operands (more than 3?) or unknown form\n";
-            return 1;
+
+        TaintMask m = taintStep(ins, t);
+        if (m) {
+            ++ntainted;
+            for (size_t i = 0; i < srcs.size(); ++i) {
+                if (m & ((TaintMask)1 << i)) perlabel[i]++;
+            }
+            fprintf(ftrace, "%s\n", reader.line().c_str());
+            fprintf(fids, "%d %llx\n", ins.id, (unsigned long long)m);
         }
+        releaseOperand(ins);
     }
+    fclose(ftrace);
+    fclose(fids);
 
-    return 0;
+    cout << "[taint] " << ntainted << " tainted instructions\n";
+    for (size_t i = 0; i < srcs.size(); ++i) {
+        cout << "[taint] label " << i << " (instruction " << srcs[i].id
+             << "): " << perlabel[i] << " instructions\n";
+    }
+    return ret;
 }
 
 /*
- * Print the instructions in L along with their src/dst parameters.
+ * Backward slice from all sources of the last instruction without loading
+ * the trace: the file is read backwards block by block, and only the
+ * worklist plus the (offset, length) of each sliced line are kept. The
+ * walk stops as soon as the worklist is empty, so a criterion near the
+ * end of a huge trace touches only its tail. The sliced lines are then
+ * copied from the trace into slice.llse.trace in trace order.
  */
-void printInstParameter(list<Inst> &L)
+int streamBackslice(const char *fname)
 {
-    for (auto &ins : L) {
-        cout << ins.id << " " << ins.addr << " " << ins.assembly << "\t";
-        cout << "src: ";
+    int fd = open(fname, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        cerr << "[Error] Cannot open file: " << fname << endl;
+        if (fd >= 0) close(fd);
+        return 1;
+    }
 
-        // Print src parameters
-        for (auto &p : ins.src) {
-            if (p.ty == Parameter::IMM) {
-                cout << "(IMM 0x" << std::hex << p.idx << std::dec << ") ";
-            }
-            else if (p.ty == Parameter::REG) {
-                cout << "(REG " << reg2string(p.reg) << p.idx << ") ";
-            }
-            else if (p.ty == Parameter::MEM) {
-                cout << "(MEM 0x" << std::hex << p.idx << std::dec << ") ";
-            }
-            else {
-                cout << "[Error] Unknown src Parameter type! ";
-            }
+    ReverseTraceReader reader(fd, st.st_size);
+    Inst ins;
+    SliceCriterion last;
+    last.id = 0;
+    last.allsrc = true;
+    map<Parameter, CritMask> wl;
+    vector<pair<off_t, size_t>> hits;
+    int ret = 0;
+    while (reader.prev(ins)) {
+        if (buildParameter(ins) != 0) {
+            releaseOperand(ins);
+            ret = 1;
+            break;
+        }
+        if (hits.empty()) {
+            seedCriterion(ins, last, 1, wl);
+            hits.push_back({reader.offset(), reader.line().size()});
+        }
+        else if (sliceStep(ins, wl)) {
+            hits.push_back({reader.offset(), reader.line().size()});
         }
+        releaseOperand(ins);
+        // Nothing left to look for: the rest of the trace is irrelevant
+        if (wl.empty()) break;
+    }
 
-        cout << ", dst: ";
-        for (auto &p : ins.dst) {
-            if (p.ty == Parameter::IMM) {
-                cout << "(IMM 0x" << std::hex << p.idx << std::dec << ") ";
-            }
-            else if (p.ty == Parameter::REG) {
-                cout << "(REG " << reg2string(p.reg) << p.idx << ") ";
-            }
-            else if (p.ty == Parameter::MEM) {
-                cout << "(MEM 0x" << std::hex << p.idx << std::dec << ") ";
-            }
-            else {
-                cout << "[Error] Unknown dst Parameter type! ";
-            }
+    if (!wl.empty()) {
+        cout << "\n[backslice] Leftover parameters in WL:\n";
+        for (auto &kv : wl) {
+            kv.first.show();
         }
         cout << endl;
     }
+    cout << "[backslice] " << hits.size() << " instructions, stopped at byte offset "
+         << (long long)reader.offset() << " of " << (long long)st.st_size << endl;
+
+    FILE *fp = fopen("slice.llse.trace", "w");
+    if (!fp) {
+        cerr << "[backslice] Cannot open slice.llse.trace\n";
+        close(fd);
+        return 1;
+    }
+    string buf;
+    for (auto it = hits.rbegin(); it != hits.rend(); ++it) {
+        buf.resize(it->second);
+        if (pread(fd, &buf[0], it->second, it->first) != (ssize_t)it->second) {
+            cerr << "[backslice] read error at offset " << (long long)it->first << endl;
+            ret = 1;
+            break;
+        }
+        fprintf(fp, "%s\n", buf.c_str());
+    }
+    fclose(fp);
+    close(fd);
+    return ret;
 }
 
 /*
- * Perform a backward slice on the instruction list L,
- * starting from the last instruction's src parameters.
+ * Fixed-size bitmap over instruction IDs.
  */
-int backslice(list<Inst> &L)
+struct Bitmap {
+    vector<uint64_t> words;
+
+    explicit Bitmap(size_t nbits) : words((nbits + 63) / 64, 0) {}
+    void set(size_t i) { words[i >> 6] |= (uint64_t)1 << (i & 63); }
+    bool test(size_t i) const { return (words[i >> 6] >> (i & 63)) & 1; }
+    size_t count() const;
+    Bitmap &operator&=(const Bitmap &other);
+    // Set bits in ascending order
+    void toIds(vector<int> &ids) const;
+};
+
+size_t Bitmap::count() const
+{
+    size_t n = 0;
+    for (uint64_t w : words) n += __builtin_popcountll(w);
+    return n;
+}
+
+Bitmap &Bitmap::operator&=(const Bitmap &other)
 {
-    // 'wl' is our working set of Parameters to track backward
-    set<Parameter> wl;
-    // 'sl' is the final sliced list of instructions
-    list<Inst> sl;
+    for (size_t i = 0; i < words.size(); ++i) words[i] &= other.words[i];
+    return *this;
+}
 
-    // Start from the last instruction
+void Bitmap::toIds(vector<int> &ids) const
+{
+    for (size_t i = 0; i < words.size(); ++i) {
+        for (uint64_t w = words[i]; w != 0; w &= w - 1) {
+            ids.push_back((int)(i * 64 + __builtin_ctzll(w)));
+        }
+    }
+}
+
+/*
+ * Whether the locations sink 'c' reads at 'ins' carry taint.
+ */
+static bool sinkTainted(const Inst &ins, const SliceCriterion &c, const TaintState &t)
+{
+    if (!c.allsrc) {
+        for (auto &p : c.loc) if (t.get(p)) return true;
+        return false;
+    }
+    for (auto *srcs : { &ins.src, &ins.src2 }) {
+        for (auto &p : *srcs) if (t.get(p)) return true;
+    }
+    return false;
+}
+
+/*
+ * Chop: the instructions through which data flows from the sources in
+ * 'srcs' to the sinks in 'sinks'. A forward taint pass from the sources
+ * and a backward slice from the sinks each mark a bitmap over instruction
+ * IDs; the chop is their intersection, written to chop.human.trace and
+ * chop.llse.trace. A sink belongs to the chop when it reads tainted data,
+ * even if it defines nothing (jmp, ret, cmp). Membership is per
+ * instruction, so an xchg whose taint arrives through one operand pair
+ * while the sink depends on the other is kept as well: the result is an
+ * over-approximation.
+ */
+int chop(list<Inst> &L, const vector<SliceCriterion> &srcs,
+         const vector<SliceCriterion> &sinks)
+{
     if (L.empty()) {
-        cout << "[backslice] No instructions in list!\n";
+        cout << "[chop] No instructions in list!\n";
         return 0;
     }
-    auto rit = L.rbegin();
-    // Add all its src parameters to the worklist
-    for (auto &param : rit->src) {
-        wl.insert(param);
+    size_t nbits = (size_t)L.back().id + 1;
+    Bitmap fwd(nbits), bwd(nbits);
+
+    // Forward: one label for all sources, seeded in trace order
+    vector<size_t> order(srcs.size());
+    for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+    sort(order.begin(), order.end(), [&](size_t x, size_t y) {
+        return srcs[x].id < srcs[y].id;
+    });
+    vector<size_t> sinkorder(sinks.size());
+    for (size_t i = 0; i < sinkorder.size(); ++i) sinkorder[i] = i;
+    sort(sinkorder.begin(), sinkorder.end(), [&](size_t x, size_t y) {
+        return sinks[x].id < sinks[y].id;
+    });
+    TaintState t;
+    size_t next = 0, nextsink = 0;
+    for (auto &ins : L) {
+        for (; next < order.size() && srcs[order[next]].id <= ins.id; ++next) {
+            if (srcs[order[next]].id == ins.id) seedTaint(ins, srcs[order[next]], 1, t);
+        }
+        for (; nextsink < sinkorder.size() && sinks[sinkorder[nextsink]].id <= ins.id; ++nextsink) {
+            const SliceCriterion &c = sinks[sinkorder[nextsink]];
+            if (c.id == ins.id && sinkTainted(ins, c, t)) fwd.set(ins.id);
+        }
+        if (taintStep(ins, t)) fwd.set(ins.id);
     }
-    // Also consider xchg's src2 if relevant
-    for (auto &param : rit->src2) {
-        wl.insert(param);
+
+    // Backward: the union of the sinks' slices, plus the sinks themselves
+    vector<vector<int>> slices;
+    multislice(L, sinks, slices, nullptr);
+    for (auto &sl : slices) {
+        for (int id : sl) bwd.set(id);
+    }
+    for (auto &c : sinks) {
+        if (c.id >= 0 && (size_t)c.id < nbits) bwd.set(c.id);
     }
 
-    // Put that last instruction in the sliced list
-    sl.push_front(*rit);
-    ++rit;
+    size_t nfwd = fwd.count(), nbwd = bwd.count();
+    fwd &= bwd;
+    vector<int> ids;
+    fwd.toIds(ids);
+    cout << "[chop] forward " << nfwd << ", backward " << nbwd
+         << ", chop " << ids.size() << " instructions\n";
+
+    writeSlice(L, ids, "chop");
+    return 0;
+}
 
-    // Walk instructions in reverse
-    while (rit != L.rend()) {
-        bool isdepMain = false;
-        bool isdepXchgSecond = false; // for xchg’s second set of dst2
+static void usage(const char *prog)
+{
+    cerr << "Usage: " << prog << " [-z] [-c <criteria file>] <tracefile>\n"
+         << "       " << prog << " -d <ddg file> <tracefile>    build a dependence graph\n"
+         << "       " << prog << " -g <ddg file>                query it from stdin\n"
+         << "       " << prog << " -t <source file> <tracefile> forward taint, streaming\n"
+         << "       " << prog << " -s <tracefile>               slice from the end, streaming\n"
+         << "       " << prog << " -r <region file> [-j <threads>] <tracefile>\n"
+         << "                                        slice each region in parallel\n"
+         << "       " << prog << " -x <source file> -c <sink file> <tracefile>\n"
+         << "                                        chop from sources to sinks\n"
+         << "  -z folds repeated iterations in the slice output\n";
+}
 
-        if (rit->dst.empty() && rit->dst2.empty()) {
-            // No destinations => not data dependent
+int main(int argc, char **argv)
+{
+    const char *critfile = nullptr;
+    const char *tracefile = nullptr;
+    const char *ddgout = nullptr;
+    const char *ddgin = nullptr;
+    const char *taintfile = nullptr;
+    const char *regionfile = nullptr;
+    int nthread = (int)thread::hardware_concurrency();
+    bool streaming = false;
+    const char *chopfile = nullptr;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "-c" && i + 1 < argc) {
+            critfile = argv[++i];
         }
-        else if (rit->opcstr == "xchg") {
-            // Check main dst
-            for (auto &dstParam : rit->dst) {
-                auto found = wl.find(dstParam);
-                if (found != wl.end()) {
-                    isdepMain = true;
-                    wl.erase(found);
-                }
-            }
-            // Check secondary dst2
-            for (auto &dstParam2 : rit->dst2) {
-                auto found2 = wl.find(dstParam2);
-                if (found2 != wl.end()) {
-                    isdepXchgSecond = true;
-                    wl.erase(found2);
-                }
-            }
-            // If we depend on the main dst
-            if (isdepMain) {
-                // push src2 into worklist
-                for (auto &src2Param : rit->src2) {
-                    wl.insert(src2Param);
-                }
-                sl.push_front(*rit);
-            }
-            // If we depend on the second dst
-            if (isdepXchgSecond) {
-                // push main src into worklist
-                for (auto &srcParam : rit->src) {
-                    wl.insert(srcParam);
-                }
-                sl.push_front(*rit);
-            }
+        else if (arg == "-d" && i + 1 < argc) {
+            ddgout = argv[++i];
+        }
+        else if (arg == "-g" && i + 1 < argc) {
+            ddgin = argv[++i];
+        }
+        else if (arg == "-t" && i + 1 < argc) {
+            taintfile = argv[++i];
+        }
+        else if (arg == "-x" && i + 1 < argc) {
+            chopfile = argv[++i];
+        }
+        else if (arg == "-z") {
+            foldslice = true;
+        }
+        else if (arg == "-s") {
+            streaming = true;
+        }
+        else if (arg == "-r" && i + 1 < argc) {
+            regionfile = argv[++i];
+        }
+        else if (arg == "-j" && i + 1 < argc) {
+            nthread = atoi(argv[++i]);
+        }
+        else if (!tracefile && arg[0] != '-') {
+            tracefile = argv[i];
         }
         else {
-            // Normal single-dst or multi-dst instructions
-            bool dependent = false;
-            for (auto &dstParam : rit->dst) {
-                auto found = wl.find(dstParam);
-                if (found != wl.end()) {
-                    dependent = true;
-                    wl.erase(found);
-                }
-            }
-            if (dependent) {
-                // Insert non-IMM sources into the worklist
-                for (auto &srcParam : rit->src) {
-                    if (!srcParam.isIMM()) {
-                        wl.insert(srcParam);
-                    }
-                }
-                // Possibly also handle src2 if relevant:
-                for (auto &src2Param : rit->src2) {
-                    if (!src2Param.isIMM()) {
-                        wl.insert(src2Param);
-                    }
-                }
-                sl.push_front(*rit);
-            }
+            usage(argv[0]);
+            return 1;
         }
-        ++rit;
     }
-
-    // Print any leftover parameters in the working list
-    if (!wl.empty()) {
-        cout << "\n[backslice] Leftover parameters in WL:\n";
-        for (auto &p : wl) {
-            p.show();
+    // Interactive queries only need the saved graph
+    if (ddgin) {
+        DepGraph g;
+        if (loadDepGraph(ddgin, g) != 0) {
+            return 1;
         }
-        cout << endl;
+        queryDepGraph(g, cin);
+        return 0;
+    }
+    if (!tracefile) {
+        usage(argv[0]);
+        return 1;
     }
 
-    // Print the sliced instructions
-    cout << "\n[backslice] Final Sliced Instructions:\n";
-    printInstParameter(sl);
+    // The reverse reader opens the file itself and never loads the trace
+    if (streaming) {
+        return streamBackslice(tracefile);
+    }
 
-    // Write the slices out to separate files in your custom format
-    printTraceHuman(sl, "slice.human.trace");
-    printTraceLLSE(sl, "slice.llse.trace");
+    vector<SliceCriterion> crit;
+    if (critfile) {
+        ifstream cfile(critfile);
+        if (!cfile.is_open()) {
+            cerr << "[Error] Cannot open file: " << critfile << endl;
+            return 1;
+        }
+        if (parseCriteria(&cfile, crit) != 0) {
+            return 1;
+        }
+    }
 
-    return 0;
-}
+    // Chop sources use the criteria syntax; -c gives the sinks
+    vector<SliceCriterion> chopsrc;
+    if (chopfile) {
+        ifstream xfile(chopfile);
+        if (!xfile.is_open()) {
+            cerr << "[Error] Cannot open file: " << chopfile << endl;
+            return 1;
+        }
+        if (parseCriteria(&xfile, chopsrc) != 0) {
+            return 1;
+        }
+        if (crit.empty()) {
+            cerr << "[Error] -x needs sink criteria (-c)\n";
+            return 1;
+        }
+    }
 
-int main(int argc, char **argv)
-{
-    if (argc != 2) {
-        cerr << "Usage: " << argv[0] << " <tracefile>\n";
-        return 1;
+    vector<Region> regions;
+    if (regionfile) {
+        ifstream rfile(regionfile);
+        if (!rfile.is_open()) {
+            cerr << "[Error] Cannot open file: " << regionfile << endl;
+            return 1;
+        }
+        if (parseRegions(&rfile, regions) != 0) {
+            return 1;
+        }
     }
 
     // Open and parse the trace
-    ifstream infile(argv[1]);
+    ifstream infile(tracefile);
     if (!infile.is_open()) {
-        cerr << "[Error] Cannot open file: " << argv[1] << endl;
+        cerr << "[Error] Cannot open file: " << tracefile << endl;
         return 1;
     }
+
+    // Taint sources use the criteria syntax; the trace is streamed, not loaded
+    if (taintfile) {
+        vector<SliceCriterion> srcs;
+        ifstream tfile(taintfile);
+        if (!tfile.is_open()) {
+            cerr << "[Error] Cannot open file: " << taintfile << endl;
+            return 1;
+        }
+        if (parseCriteria(&tfile, srcs) != 0) {
+            return 1;
+        }
+        return forwardTaint(&infile, srcs);
+    }
     parseTrace(&infile, &instlist);
     infile.close();
 
@@ -536,8 +1636,23 @@ int main(int argc, char **argv)
         return 1;
     }
 
-    // Perform a backward slice from the last instruction
-    if (backslice(instlist) != 0) {
+    if (ddgout) {
+        DepGraph g;
+        buildDepGraph(instlist, g);
+        cout << "[ddg] " << g.ids.size() << " nodes, " << g.dep.size() << " edges\n";
+        return saveDepGraph(g, ddgout);
+    }
+
+    if (regionfile) {
+        return sliceRegions(instlist, regions, nthread);
+    }
+    if (chopfile) {
+        return chop(instlist, chopsrc, crit);
+    }
+
+    // Slice every criterion in one pass, or from the last instruction
+    int ret = crit.empty() ? backslice(instlist) : backslice(instlist, crit);
+    if (ret != 0) {
         cerr << "[Error] backslice encountered an issue.\n";
         return 1;
     }
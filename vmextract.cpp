@@ -7,13 +7,27 @@
 #include <stack>
 #include <vector>
 #include <set>
+#include <algorithm>
+#include <unordered_map>
 #include <cstdint>    // for uint64_t
 #include <cstdio>     // for printf, FILE, etc.
+#include <cstdlib>    // for atoi
+#include <cstring>    // for memchr
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>    // AVX2 opcode scan
+#endif
 
 using namespace std;
 
 #include "core.hpp"
 #include "parser.hpp"
+#include "semantics.hpp"
 
 /*
  * Global list of instructions from the trace.
@@ -21,12 +35,14 @@ using namespace std;
 list<Inst> instlist;
 
 /*
- * Data structures for identifying functions (placeholders).
+ * Data structures for identifying functions. A FuncBody is one dynamic
+ * activation (trace IDs start..end); a Func collects the activations of
+ * one entry address together with its dynamic instruction counts.
  */
 struct FuncBody {
     int start;
     int end;
-    int length;             // end - start
+    int length;             // end - start + 1
     uint64_t startAddr;     // changed to 64-bit
     uint64_t endAddr;       // changed to 64-bit
     int loopn;
@@ -35,6 +51,10 @@ struct FuncBody {
 struct Func {
     uint64_t callAddr;      // changed to 64-bit
     list<FuncBody*> body;
+    uint64_t calls = 0;     // activations, tail jumps included
+    uint64_t selfn = 0;     // instructions executed in this function's frames
+    uint64_t incln = 0;     // instructions executed while it was active
+    int active = 0;         // open frames, so recursion is counted once
 };
 
 /*
@@ -84,514 +104,2147 @@ void printInstlist(list<Inst>* L, map<string,int>* m)
 }
 
 /*
- * Build a function map (placeholder logic).
+ * Build a map (mnemonic -> unique int).
+ */
+map<string,int>* buildOpcodeMap(list<Inst>* L)
+{
+    auto* mp = new map<string,int>;
+    for (auto &ins : *L) {
+        if (mp->find(ins.opcstr) == mp->end()) {
+            (*mp)[ins.opcstr] = (int)mp->size() + 1;
+        }
+    }
+    return mp;
+}
+
+/*
+ * Lookup numeric opcode from a mnemonic (returns 0 if not found).
+ */
+int getOpc(const string &s, map<string,int>* m)
+{
+    auto it = m->find(s);
+    if (it != m->end()) {
+        return it->second;
+    }
+    return 0;
+}
+
+/*
+ * Check if integer opcode i is in the jump set.
+ */
+bool isjump(int i, set<int>* jumpset)
+{
+    return (jumpset->find(i) != jumpset->end());
+}
+
+/*
+ * Build the call tree with a shadow stack in one pass. A call opens a frame
+ * for the address executed next (so indirect calls need no operand
+ * parsing), keyed by the stack slot of its return address. A ret whose rsp
+ * is a frame's slot closes that frame and any deeper ones left open; a ret
+ * matching no frame is counted as unmatched. A jmp to a known entry made
+ * while the return address is on top of the stack is a tail jump: it
+ * closes the current frame and opens one for the target in its place.
+ * Instructions before the first call belong to a root function at the
+ * trace's first address.
+ */
+struct Frame {
+    Func *fn;
+    FuncBody *fb;
+    uint64_t slot;      // address of the return address on the stack
+};
+
+static int unmatchedrets = 0;
+static int tailjumps = 0;
+
+static Func *getFunc(map<uint64_t, Func*>* funcmap, uint64_t entry)
+{
+    Func *&fn = (*funcmap)[entry];
+    if (!fn) {
+        fn = new Func;
+        fn->callAddr = entry;
+    }
+    return fn;
+}
+
+static void openFrame(vector<Frame> &stk, Func *fn, const Inst &ins, uint64_t slot)
+{
+    FuncBody *fb = new FuncBody{ins.id, ins.id, 0, ins.addrn, ins.addrn, 0};
+    fn->body.push_back(fb);
+    fn->calls++;
+    fn->active++;
+    stk.push_back(Frame{fn, fb, slot});
+}
+
+static void closeFrame(vector<Frame> &stk, const Inst &last)
+{
+    Frame &f = stk.back();
+    f.fb->end = last.id;
+    f.fb->endAddr = last.addrn;
+    f.fb->length = f.fb->end - f.fb->start + 1;
+    if (--f.fn->active == 0) f.fn->incln += f.fb->length;
+    stk.pop_back();
+}
+
+map<uint64_t, Func*>* buildFuncList(list<Inst>* L)
+{
+    auto* funcmap = new map<uint64_t, Func*>;
+    vector<Frame> stk;
+    const Inst *prev = nullptr;
+    enum { NONE, CALL, TAIL } pending = NONE;
+    uint64_t slot = 0;
+
+    unmatchedrets = tailjumps = 0;
+    for (auto &ins : *L) {
+        if (!prev) {
+            openFrame(stk, getFunc(funcmap, ins.addrn), ins, UINT64_MAX);
+        }
+        else if (pending == CALL) {
+            openFrame(stk, getFunc(funcmap, ins.addrn), ins, slot);
+        }
+        else if (pending == TAIL) {
+            auto pos = funcmap->find(ins.addrn);
+            if (pos != funcmap->end() && pos->second != stk.back().fn) {
+                closeFrame(stk, *prev);
+                openFrame(stk, pos->second, ins, slot);
+                tailjumps++;
+            }
+        }
+        pending = NONE;
+
+        stk.back().fn->selfn++;
+
+        uint64_t rsp = ins.ctxreg[6];
+        if (ins.opcstr == "call") {
+            pending = CALL;
+            slot = rsp - 8;
+        }
+        else if (ins.opcstr == "ret") {
+            size_t k = stk.size();
+            while (k > 1 && stk[k - 1].slot < rsp) k--;
+            if (k > 1 && stk[k - 1].slot == rsp) {
+                while (stk.size() >= k) closeFrame(stk, ins);
+            }
+            else {
+                unmatchedrets++;
+            }
+        }
+        else if (isjump(ins.opc, jmpset) && stk.size() > 1 && stk.back().slot == rsp) {
+            pending = TAIL;
+            slot = rsp;
+        }
+        prev = &ins;
+    }
+    while (!stk.empty()) closeFrame(stk, *prev);
+    return funcmap;
+}
+
+/*
+ * Print the functions by inclusive instruction count.
+ */
+void printFuncmap(map<uint64_t, Func*>* funcmap)
+{
+    vector<Func*> fv;
+    for (auto &kv : *funcmap) fv.push_back(kv.second);
+    sort(fv.begin(), fv.end(), [](Func *a, Func *b) {
+        return a->incln != b->incln ? a->incln > b->incln : a->callAddr < b->callAddr;
+    });
+    cout << "entry\tcalls\tself\tinclusive\tloops\n";
+    for (Func *fn : fv) {
+        int loopn = 0;
+        for (FuncBody *fb : fn->body) loopn += fb->loopn;
+        cout << hex << fn->callAddr << dec << "\t" << fn->calls << "\t"
+             << fn->selfn << "\t" << fn->incln << "\t" << loopn << endl;
+    }
+    cout << "functions: " << fv.size() << ", tail jumps: " << tailjumps
+         << ", unmatched returns: " << unmatchedrets << endl;
+}
+
+/*
+ * Count how many indirect jumps by checking if operand[0] is not IMM.
+ */
+void countindjumps(list<Inst>* L)
+{
+    int indjumpnum = 0;
+    for (auto &ins : *L) {
+        if (isjump(ins.opc, jmpset)) {
+            // If operand[0] is not IMM => indirect jump
+            if (ins.oprd[0]->ty != OperandType::IMM) {
+                ++indjumpnum;
+                cout << ins.addr << "\t" << ins.opcstr << " " << ins.oprs[0] << endl;
+            }
+        }
+    }
+    cout << "number of indirect jumps: " << indjumpnum << endl;
+}
+
+/*
+ * Peephole patterns. A PAIR rule cancels an instruction against the one
+ * kept right before it (operands must match: the first one, or all of
+ * them for SAMEALL); SELF rules look at a single instruction whose two
+ * register operands are the same.
+ */
+enum class PeepKind { PAIR, SAMEALL, NOP_MOV, ZERO_XOR };
+
+struct PeepRule {
+    const char *first;
+    const char *second;
+    PeepKind kind;
+    uint64_t count;     // instructions removed (or rewritten)
+};
+
+static PeepRule peeprules[] = {
+    {"push", "pop",  PeepKind::PAIR,    0},
+    {"pop",  "push", PeepKind::PAIR,    0},
+    {"add",  "sub",  PeepKind::SAMEALL, 0},
+    {"sub",  "add",  PeepKind::SAMEALL, 0},
+    {"inc",  "dec",  PeepKind::PAIR,    0},
+    {"dec",  "inc",  PeepKind::PAIR,    0},
+    {"not",  "not",  PeepKind::PAIR,    0},
+    {"neg",  "neg",  PeepKind::PAIR,    0},
+    {"mov",  "",     PeepKind::NOP_MOV,  0},   // mov r,r (not 32-bit: that zero-extends)
+    {"xor",  "",     PeepKind::ZERO_XOR, 0},   // xor r,r: treated as mov r, 0x0
+};
+
+static bool sameregs(const Inst &ins)
+{
+    return ins.oprnum == 2 && ins.oprd[0] && ins.oprd[1]
+        && ins.oprd[0]->ty == OperandType::REG
+        && ins.oprd[1]->ty == OperandType::REG
+        && ins.oprd[0]->field[0] == ins.oprd[1]->field[0];
+}
+
+// Give "xor r, r" the semantics of "mov r, 0x0", which has no input
+// dependence on r. The text (opcstr, operands, assembly) is left alone, so
+// signatures, the CFG and trace output still show the real instruction.
+static void rewritezero(Inst &ins)
+{
+    Inst zero;
+    zero.oprs.push_back("0x0");
+    parseOperand(zero);
+    delete ins.oprd[1];
+    ins.oprd[1] = zero.oprd[0];
+    ins.desc = getOpDesc("mov", ins.oprnum);
+}
+
+/*
+ * Table-driven peephole pass. The rules are compiled into two tables
+ * indexed by opcode ID (pair rule keyed on the earlier instruction, self
+ * rule keyed on the instruction itself), and the trace is scanned once
+ * keeping the surviving instructions on a stack: an instruction that
+ * cancels the stack top pops it, so nested cancellations such as
+ * push a; push b; pop b; pop a collapse in the same O(n) pass.
+ */
+void peephole(list<Inst>* L)
+{
+    size_t nopc = instenum->size() + 1;
+    vector<int> pairrule(nopc, -1), selfrule(nopc, -1), second(nopc, 0);
+    int nrules = (int)(sizeof(peeprules) / sizeof(peeprules[0]));
+    for (int r = 0; r < nrules; ++r) {
+        int o1 = getOpc(peeprules[r].first, instenum);
+        if (o1 == 0) continue;
+        if (peeprules[r].kind == PeepKind::PAIR || peeprules[r].kind == PeepKind::SAMEALL) {
+            int o2 = getOpc(peeprules[r].second, instenum);
+            if (o2 == 0) continue;
+            pairrule[o1] = r;
+            second[o1] = o2;
+        }
+        else {
+            selfrule[o1] = r;
+        }
+    }
+
+    vector<list<Inst>::iterator> stk;
+    for (auto it = L->begin(); it != L->end(); ) {
+        int sr = (size_t)it->opc < nopc ? selfrule[it->opc] : -1;
+        if (sr >= 0 && sameregs(*it)) {
+            PeepRule &rule = peeprules[sr];
+            if (rule.kind == PeepKind::NOP_MOV && it->oprd[0]->bit != 32) {
+                rule.count++;
+                it = L->erase(it);
+                continue;
+            }
+            if (rule.kind == PeepKind::ZERO_XOR) {
+                rule.count++;
+                rewritezero(*it);
+            }
+        }
+
+        if (!stk.empty()) {
+            auto top = stk.back();
+            int pr = pairrule[top->opc];
+            if (pr >= 0 && second[top->opc] == it->opc
+                && !top->oprs.empty() && top->oprs.size() == it->oprs.size()
+                && (peeprules[pr].kind == PeepKind::SAMEALL ? top->oprs == it->oprs
+                                                             : top->oprs[0] == it->oprs[0])) {
+                peeprules[pr].count += 2;
+                stk.pop_back();
+                L->erase(top);
+                it = L->erase(it);
+                continue;
+            }
+        }
+        stk.push_back(it);
+        ++it;
+    }
+
+    cout << "[peephole]";
+    for (int r = 0; r < nrules; ++r) {
+        if (peeprules[r].count == 0) continue;
+        cout << " " << peeprules[r].first;
+        if (*peeprules[r].second) cout << "/" << peeprules[r].second;
+        cout << (peeprules[r].kind == PeepKind::ZERO_XOR ? " rewrote " : " removed ")
+             << peeprules[r].count << ";";
+    }
+    cout << endl;
+}
+
+/*
+ * A structure capturing a block of instructions (push or pop) we consider a context save/restore.
+ */
+struct ctxswitch {
+    list<Inst>::iterator begin;
+    list<Inst>::iterator end;
+    uint64_t sd;  // stack depth or pointer (64-bit)
+};
+
+/*
+ * Global lists storing context saves and restores, then pairing them up.
+ */
+list<ctxswitch> ctxsave;
+list<ctxswitch> ctxrestore;
+list<pair<ctxswitch, ctxswitch>> ctxswh;
+
+/*
+ * Context switch detection settings: a save (restore) is a run of at least
+ * ctxrunlen consecutive "push <reg>" ("pop <reg>") with distinct registers
+ * from ctxregs. Set from the command line (-n, -R).
+ */
+static int ctxrunlen = 7;
+static vector<string> ctxregs = {
+    "rax","rbx","rcx","rdx","rsi","rdi","rbp","rsp",
+    "r8","r9","r10","r11","r12","r13","r14","r15"
+};
+
+/*
+ * Record a finished push or pop run [b, e) if it is long enough.
+ */
+static void closerun(bool ispush, list<Inst>::iterator b, list<Inst>::iterator e,
+                     int len, list<Inst>::iterator last)
+{
+    if (len < ctxrunlen) return;
+
+    ctxswitch cs;
+    cs.begin = b;
+    cs.end   = e;
+    if (ispush) {
+        // Stack pointer once the registers are saved; ctxreg[6] is rsp.
+        // A run that ends the trace has no later instruction to read it from.
+        cs.sd = (e != last) ? e->ctxreg[6] : std::prev(e)->ctxreg[6] - 8;
+        ctxsave.push_back(cs);
+        cout << "[vmextract] push found:\n";
+    } else {
+        // Stack pointer before the registers are restored
+        cs.sd = b->ctxreg[6];
+        ctxrestore.push_back(cs);
+        cout << "[vmextract] pop found:\n";
+    }
+    cout << b->id << " " << b->addr << " " << b->assembly << endl;
+}
+
+/*
+ * Pair each context restore with the latest unmatched save at the same
+ * stack depth, walking saves and restores in execution order. Open saves
+ * are kept per depth in a hash map, each bucket used as a stack, so nested
+ * and repeated VM entries pair correctly in O(S+R). Pairs are stored in
+ * ctxswh in order of their save.
+ */
+void pairctx()
+{
+    unordered_map<uint64_t, vector<const ctxswitch*>> open;
+    auto sv = ctxsave.begin();
+    auto rs = ctxrestore.begin();
+    int unmatched = 0;
+
+    while (rs != ctxrestore.end()) {
+        if (sv != ctxsave.end() && sv->begin->id < rs->begin->id) {
+            open[sv->sd].push_back(&*sv);
+            ++sv;
+            continue;
+        }
+        auto bucket = open.find(rs->sd);
+        if (bucket == open.end() || bucket->second.empty()) {
+            unmatched++;
+        } else {
+            ctxswh.push_back({*bucket->second.back(), *rs});
+            bucket->second.pop_back();
+        }
+        ++rs;
+    }
+    for (auto &kv : open) unmatched += (int)kv.second.size();
+    unmatched += (int)std::distance(sv, ctxsave.end());
+
+    ctxswh.sort([](const pair<ctxswitch, ctxswitch> &a,
+                   const pair<ctxswitch, ctxswitch> &b) {
+        return a.first.begin->id < b.first.begin->id;
+    });
+    cout << "[vmextract] " << ctxswh.size() << " context switch pairs, "
+         << unmatched << " unmatched saves/restores\n";
+}
+
+/*
+ * Signature scanning over the opcode column. The trace's opcode IDs (and
+ * the kind of each first operand) are copied into contiguous arrays, and
+ * one compare pass per opcode turns a column into a bitmap, bit i set if
+ * instruction i matches; on CPUs with AVX2 the compare runs 8 opcodes (32
+ * operand kinds) per instruction. A signature such as "pushfq,push*6" or
+ * "movzx,jmp/r" is then matched for every start position at once by
+ * AND-ing its elements' bitmaps shifted by their offset.
+ */
+struct OpcColumn {
+    vector<int32_t> opc;
+    vector<uint8_t> kind;   // first operand: 0 none, 1 reg, 2 mem, 3 imm
+    vector<int> id;         // trace ID
+};
+
+typedef vector<uint64_t> OpcBitmap;
+
+static OpcColumn buildcolumn(list<Inst>* L)
+{
+    OpcColumn col;
+    for (auto &ins : *L) {
+        uint8_t k = 0;
+        if (ins.oprnum >= 1 && ins.oprd[0]) {
+            switch (ins.oprd[0]->ty) {
+            case OperandType::REG: k = 1; break;
+            case OperandType::MEM: k = 2; break;
+            case OperandType::IMM: k = 3; break;
+            default: break;
+            }
+        }
+        col.opc.push_back(ins.opc);
+        col.kind.push_back(k);
+        col.id.push_back(ins.id);
+    }
+    return col;
+}
+
+template <typename T>
+static void eqscalar(const T *a, size_t from, size_t n, T v, uint64_t *out)
+{
+    for (size_t i = from; i < n; ++i) {
+        if (a[i] == v) out[i / 64] |= (uint64_t)1 << (i % 64);
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx2")))
+static size_t eqavx2(const int32_t *a, size_t n, int32_t v, uint64_t *out)
+{
+    __m256i key = _mm256_set1_epi32(v);
+    size_t w = 0;
+    for (; (w + 1) * 64 <= n; ++w) {
+        uint64_t bits = 0;
+        for (int k = 0; k < 8; ++k) {
+            __m256i x = _mm256_loadu_si256((const __m256i *)(a + w * 64 + 8 * k));
+            __m256i eq = _mm256_cmpeq_epi32(x, key);
+            bits |= (uint64_t)(uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(eq)) << (8 * k);
+        }
+        out[w] = bits;
+    }
+    return w * 64;
+}
+
+__attribute__((target("avx2")))
+static size_t eqavx2(const uint8_t *a, size_t n, uint8_t v, uint64_t *out)
+{
+    __m256i key = _mm256_set1_epi8((char)v);
+    size_t w = 0;
+    for (; (w + 1) * 64 <= n; ++w) {
+        __m256i lo = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(a + w * 64)), key);
+        __m256i hi = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(a + w * 64 + 32)), key);
+        out[w] = (uint64_t)(uint32_t)_mm256_movemask_epi8(lo)
+               | (uint64_t)(uint32_t)_mm256_movemask_epi8(hi) << 32;
+    }
+    return w * 64;
+}
+
+static const bool hasavx2 = __builtin_cpu_supports("avx2");
+#else
+static const bool hasavx2 = false;
+
+template <typename T>
+static size_t eqavx2(const T *, size_t, T, uint64_t *) { return 0; }
+#endif
+
+// Bitmap of the positions where a[i] == v
+template <typename T>
+static OpcBitmap eqbitmap(const vector<T> &a, T v)
+{
+    OpcBitmap bm((a.size() + 63) / 64, 0);
+    size_t done = hasavx2 ? eqavx2(a.data(), a.size(), v, bm.data()) : 0;
+    eqscalar(a.data(), done, a.size(), v, bm.data());
+    return bm;
+}
+
+// m &= b shifted down by k (bit i of b moves to i - k)
+static void andshifted(OpcBitmap &m, const OpcBitmap &b, size_t k)
+{
+    size_t q = k / 64, r = k % 64;
+    for (size_t w = 0; w < m.size(); ++w) {
+        uint64_t lo = w + q < b.size() ? b[w + q] : 0;
+        uint64_t hi = w + q + 1 < b.size() ? b[w + q + 1] : 0;
+        m[w] &= r ? (lo >> r | hi << (64 - r)) : lo;
+    }
+}
+
+// m |= b shifted up by k (bit i of b moves to i + k)
+static void orshifted(OpcBitmap &m, const OpcBitmap &b, size_t k)
+{
+    size_t q = k / 64, r = k % 64;
+    for (size_t w = m.size(); w-- > q; ) {
+        uint64_t lo = b[w - q];
+        uint64_t below = w - q >= 1 ? b[w - q - 1] : 0;
+        m[w] |= r ? (lo << r | below >> (64 - r)) : lo;
+    }
+}
+
+/*
+ * Start positions of a signature: comma-separated elements
+ * "<mnemonic>[/r|/m|/i][*<count>]", the suffix requiring a register,
+ * memory or immediate first operand. Returns false on a malformed one.
+ */
+static bool scansig(const OpcColumn &col, const string &sig, OpcBitmap &starts)
+{
+    starts.assign((col.opc.size() + 63) / 64, ~(uint64_t)0);
+    if (!col.opc.empty() && col.opc.size() % 64) {
+        starts.back() = ((uint64_t)1 << (col.opc.size() % 64)) - 1;
+    }
+    istringstream buf(sig);
+    string elem;
+    size_t off = 0;
+    while (getline(buf, elem, ',')) {
+        int count = 1;
+        size_t star = elem.find('*');
+        if (star != string::npos) {
+            count = atoi(elem.c_str() + star + 1);
+            elem.resize(star);
+        }
+        uint8_t kind = 0;
+        size_t slash = elem.find('/');
+        if (slash != string::npos) {
+            string k = elem.substr(slash + 1);
+            kind = k == "r" ? 1 : k == "m" ? 2 : k == "i" ? 3 : 0;
+            if (kind == 0) return false;
+            elem.resize(slash);
+        }
+        if (elem.empty() || count < 1) return false;
+
+        OpcBitmap bm = eqbitmap(col.opc, (int32_t)getOpc(elem, instenum));
+        if (kind) {
+            OpcBitmap km = eqbitmap(col.kind, kind);
+            for (size_t w = 0; w < bm.size(); ++w) bm[w] &= km[w];
+        }
+        for (int c = 0; c < count; ++c) andshifted(starts, bm, off++);
+    }
+    return off > 0;
+}
+
+/*
+ * Write the trace IDs where each signature matches to fname, each list
+ * headed by "# <signature> <matches>".
+ */
+void outputsigs(list<Inst>* L, const vector<string> &sigs, string fname)
+{
+    OpcColumn col = buildcolumn(L);
+    FILE *fp = fopen(fname.c_str(), "w");
+    if (!fp) {
+        cerr << "[signatures] Failed to open " << fname << endl;
+        return;
+    }
+    for (auto &sig : sigs) {
+        OpcBitmap starts;
+        if (!scansig(col, sig, starts)) {
+            cerr << "[signatures] bad signature: " << sig << endl;
+            continue;
+        }
+        uint64_t n = 0;
+        for (uint64_t w : starts) n += __builtin_popcountll(w);
+        fprintf(fp, "# %s %llu\n", sig.c_str(), (unsigned long long)n);
+        for (size_t w = 0; w < starts.size(); ++w) {
+            for (uint64_t bits = starts[w]; bits; bits &= bits - 1) {
+                fprintf(fp, "%d\n", col.id[w * 64 + __builtin_ctzll(bits)]);
+            }
+        }
+        cout << "[signatures] " << sig << ": " << n << " matches\n";
+    }
+    fclose(fp);
+}
+
+/*
+ * Search the instruction list L and extract "VM" snippets: runs of
+ * ctxrunlen or more pushes or pops of distinct registers.
+ *
+ * One pass over the trace, visiting only candidates from the opcode-column
+ * scan: the current run is extended while the opcode stays the same and
+ * the register is new to the run; anything else closes it. A repeated
+ * register starts a new run at that instruction.
+ */
+void vmextract(list<Inst>* L)
+{
+    int opcpush = getOpc("push", instenum);
+
+    // Only instructions inside ctxrunlen consecutive pushes (pops) can be
+    // part of a save (restore): mark them with the signature scanner
+    OpcColumn col = buildcolumn(L);
+    OpcBitmap cand(((col.opc.size() + 63) / 64), 0);
+    for (const char *mn : {"push", "pop"}) {
+        OpcBitmap starts;
+        scansig(col, string(mn) + "/r*" + to_string(ctxrunlen), starts);
+        for (int k = 0; k < ctxrunlen; ++k) orshifted(cand, starts, k);
+    }
+
+    map<string,int> regbit;
+    for (auto &r : ctxregs) {
+        regbit.emplace(r, (int)regbit.size());
+    }
+
+    int runopc = 0;         // push, pop, or 0 outside a run
+    int runlen = 0;
+    uint64_t runregs = 0;   // registers seen in the run, by regbit index
+    list<Inst>::iterator runbegin = L->end();
+
+    size_t pos = 0;
+    for (auto it = L->begin(); it != L->end(); ++it, ++pos) {
+        int bit = -1;
+        if ((cand[pos / 64] >> (pos % 64) & 1) && it->oprs.size() == 1) {
+            auto rb = regbit.find(it->oprs[0]);
+            if (rb != regbit.end()) bit = rb->second;
+        }
+
+        if (bit >= 0 && it->opc == runopc && !(runregs >> bit & 1)) {
+            runregs |= (uint64_t)1 << bit;
+            runlen++;
+            continue;
+        }
+
+        if (runopc != 0) {
+            closerun(runopc == opcpush, runbegin, it, runlen, L->end());
+        }
+        if (bit >= 0) {
+            runopc   = it->opc;
+            runlen   = 1;
+            runregs  = (uint64_t)1 << bit;
+            runbegin = it;
+        } else {
+            runopc = 0;
+        }
+    }
+    if (runopc != 0) {
+        closerun(runopc == opcpush, runbegin, L->end(), runlen, L->end());
+    }
+
+    pairctx();
+}
+
+/*
+ * Static interval tree over the paired VM regions, for nested
+ * (multi-layer) virtualizers. Regions are kept in order of their first
+ * trace ID, with a max-end segment tree on top: the regions containing a
+ * point are those starting at or before it whose end reaches it, so the
+ * innermost one is the rightmost such region, found in O(log n). A
+ * region's parent is the innermost region enclosing it, and its depth is
+ * the parent's plus one (outermost regions have depth 0).
+ */
+class RegionTree {
+public:
+    struct Node {
+        int begin, end;     // first/last trace ID
+        uint64_t sd;        // stack depth of the save
+        int parent;         // index into regions(), or -1
+        int depth;
+    };
+
+    RegionTree(list<pair<ctxswitch, ctxswitch>>* ctxswh);
+
+    // Innermost region containing trace ID id, or -1
+    int innermost(int id) const;
+    const vector<Node> &regions() const { return nodes; }
+
+private:
+    vector<Node> nodes;
+    vector<int> maxend;     // segment tree, leaves at [leaves, 2 * leaves)
+    size_t leaves;
+
+    // Rightmost region i < hi with end >= minend, or -1
+    int rightmost(size_t hi, int minend) const;
+    int rightmost(size_t node, size_t lo, size_t width, size_t hi, int minend) const;
+};
+
+RegionTree::RegionTree(list<pair<ctxswitch, ctxswitch>>* ctxswh)
+{
+    for (auto &pairCS : *ctxswh) {
+        nodes.push_back(Node{pairCS.first.begin->id, std::prev(pairCS.second.end)->id,
+                             pairCS.first.sd, -1, 0});
+    }
+    // pairctx sorts by save, so nodes are already ordered by begin
+    leaves = 1;
+    while (leaves < nodes.size()) leaves *= 2;
+    maxend.assign(2 * leaves, INT32_MIN);
+    for (size_t i = 0; i < nodes.size(); ++i) maxend[leaves + i] = nodes[i].end;
+    for (size_t i = leaves - 1; i >= 1; --i) {
+        maxend[i] = max(maxend[2 * i], maxend[2 * i + 1]);
+    }
+
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        int p = rightmost(i, nodes[i].end);
+        nodes[i].parent = p;
+        nodes[i].depth = p < 0 ? 0 : nodes[p].depth + 1;
+    }
+}
+
+int RegionTree::rightmost(size_t node, size_t lo, size_t width, size_t hi, int minend) const
+{
+    if (lo >= hi || maxend[node] < minend) return -1;
+    if (width == 1) return (int)lo;
+    int r = rightmost(2 * node + 1, lo + width / 2, width / 2, hi, minend);
+    if (r >= 0) return r;
+    return rightmost(2 * node, lo, width / 2, hi, minend);
+}
+
+int RegionTree::rightmost(size_t hi, int minend) const
+{
+    if (nodes.empty()) return -1;
+    return rightmost(1, 0, leaves, hi, minend);
+}
+
+int RegionTree::innermost(int id) const
+{
+    auto it = upper_bound(nodes.begin(), nodes.end(), id,
+                          [](int v, const Node &n) { return v < n.begin; });
+    return rightmost((size_t)(it - nodes.begin()), id);
+}
+
+/*
+ * Fingerprint of a region's static instruction sequence: a polynomial
+ * (FNV-1a style) hash over each instruction's address and opcode.
+ */
+static uint64_t fingerprint(list<Inst>::iterator i1, list<Inst>::iterator i2)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (auto it = i1; it != i2; ++it) {
+        h = (h ^ it->addrn) * 0x100000001b3ULL;
+        h = (h ^ (uint64_t)it->opc) * 0x100000001b3ULL;
+    }
+    return h;
+}
+
+// Same static instruction sequence (hash collisions are checked here)
+static bool samestatic(list<Inst>::iterator a1, list<Inst>::iterator a2,
+                       list<Inst>::iterator b1, list<Inst>::iterator b2)
+{
+    for (; a1 != a2 && b1 != b2; ++a1, ++b1) {
+        if (a1->addrn != b1->addrn || a1->opc != b1->opc) return false;
+    }
+    return a1 == a2 && b1 == b2;
+}
+
+/*
+ * Copy bytes [off, off+len) of fdin to a new file fname after the header
+ * line(s), in the kernel with copy_file_range where the file systems allow
+ * it, else by pread/write.
+ */
+static bool copyrange(int fdin, uint64_t off, uint64_t len, const string &fname,
+                      const string &header)
+{
+    int fdout = open(fname.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fdout < 0) return false;
+    if (write(fdout, header.data(), header.size()) != (ssize_t)header.size()) {
+        close(fdout);
+        return false;
+    }
+    loff_t in = off;
+    bool kernel = true;
+    while (len > 0) {
+        ssize_t n;
+        if (kernel) {
+            n = copy_file_range(fdin, &in, fdout, nullptr, len, 0);
+            if (n < 0 && (errno == EXDEV || errno == EINVAL || errno == ENOSYS
+                          || errno == EOPNOTSUPP)) {
+                kernel = false;
+                continue;
+            }
+        }
+        else {
+            char buf[1 << 16];
+            n = pread(fdin, buf, min<uint64_t>(len, sizeof(buf)), in);
+            if (n > 0 && write(fdout, buf, n) != n) n = -1;
+            if (n > 0) in += n;
+        }
+        if (n <= 0) break;
+        len -= n;
+    }
+    close(fdout);
+    return len == 0;
+}
+
+// Re-format [begin, end) in the trace format (regions without file offsets)
+static bool formatrange(list<Inst>::iterator begin, list<Inst>::iterator end,
+                        const string &fname, const string &header)
+{
+    FILE* fp = fopen(fname.c_str(), "w");
+    if (!fp) return false;
+    fputs(header.c_str(), fp);
+    for (auto it = begin; it != end; ++it) {
+        fprintf(fp, "%s;%s;", it->addr.c_str(), it->assembly.c_str());
+        // print context registers
+        for (int j = 0; j < 8; ++j) {
+            fprintf(fp, "%llx,", (unsigned long long)it->ctxreg[j]);
+        }
+        // print read/write addresses
+        fprintf(fp, "%llx,%llx\n",
+                (unsigned long long)it->raddr,
+                (unsigned long long)it->waddr);
+    }
+    fclose(fp);
+    return true;
+}
+
+/*
+ * Write the extracted VM snippets, one file per distinct handler: regions
+ * with the same static instruction sequence form a cluster, and only the
+ * first region of each cluster is written (vm1.txt, vm2.txt, etc.).
+ * vmclusters.txt lists per cluster its file number, region count, length,
+ * nesting depth and the instruction-ID range of every member. Each vmN.txt
+ * starts with "#vm <n> depth <d> parent <m>", m being the file of the
+ * enclosing region's cluster (0 for an outermost region).
+ *
+ * A region is exported as the byte range of the trace file between its
+ * first and last line, so the file holds the original lines (including
+ * those the peephole pass removed, which mgse simply re-executes); only
+ * regions starting or ending inside an expanded #fold block are
+ * re-formatted. nwriters threads write the files.
+ */
+void outputvm(list<pair<ctxswitch, ctxswitch>>* ctxswh, const RegionTree &tree,
+              const char *tracefile, int nwriters)
+{
+    struct Cluster {
+        list<Inst>::iterator begin, end;    // representative region
+        int rep;                            // its index in tree.regions()
+        int length;
+        vector<pair<int,int>> members;      // first/last id of each region
+    };
+    vector<Cluster> clusters;
+    unordered_map<uint64_t, vector<int>> byhash;
+    vector<int> regioncl;                   // region index -> cluster
+
+    for (auto &pairCS : *ctxswh) {
+        auto i1 = pairCS.first.begin;
+        auto i2 = pairCS.second.end;
+        pair<int,int> range(i1->id, std::prev(i2)->id);
+
+        vector<int> &bucket = byhash[fingerprint(i1, i2)];
+        int found = -1;
+        for (int c : bucket) {
+            if (samestatic(clusters[c].begin, clusters[c].end, i1, i2)) {
+                found = c;
+                break;
+            }
+        }
+        if (found < 0) {
+            found = (int)clusters.size();
+            clusters.push_back(Cluster{i1, i2, (int)regioncl.size(),
+                                       (int)std::distance(i1, i2), {}});
+            bucket.push_back(found);
+        }
+        clusters[found].members.push_back(range);
+        regioncl.push_back(found);
+    }
+
+    FILE* fc = fopen("vmclusters.txt", "w");
+    if (!fc) {
+        cerr << "[outputvm] Failed to open vmclusters.txt\n";
+    }
+    else {
+        int n = 1;
+        for (auto &cl : clusters) {
+            fprintf(fc, "%d %zu %d %d", n++, cl.members.size(), cl.length,
+                    tree.regions()[cl.rep].depth);
+            for (auto &m : cl.members) {
+                fprintf(fc, " %d-%d", m.first, m.second);
+            }
+            fprintf(fc, "\n");
+        }
+        fclose(fc);
+    }
+
+    int fdin = open(tracefile, O_RDONLY);
+    atomic<size_t> next(0);
+    atomic<int> nformatted(0);
+    mutex errlock;
+    auto writer = [&]() {
+        for (size_t i = next++; i < clusters.size(); i = next++) {
+            Cluster &cl = clusters[i];
+            string vmfile = "vm" + to_string(i + 1) + ".txt";
+            const Inst &first = *cl.begin;
+            const Inst &last = *std::prev(cl.end);
+            const RegionTree::Node &r = tree.regions()[cl.rep];
+            string header = "#vm " + to_string(i + 1) + " depth " + to_string(r.depth)
+                + " parent " + to_string(r.parent < 0 ? 0 : regioncl[r.parent] + 1) + "\n";
+            bool ok;
+            if (fdin >= 0 && first.off != UINT64_MAX && last.off != UINT64_MAX) {
+                ok = copyrange(fdin, first.off, last.off + last.len - first.off, vmfile, header);
+            }
+            else {
+                ok = formatrange(cl.begin, cl.end, vmfile, header);
+                nformatted++;
+            }
+            if (!ok) {
+                lock_guard<mutex> g(errlock);
+                cerr << "[outputvm] Failed to write " << vmfile << endl;
+            }
+        }
+    };
+    vector<thread> pool;
+    for (int t = 1; t < nwriters; ++t) pool.emplace_back(writer);
+    writer();
+    for (auto &t : pool) t.join();
+    if (fdin >= 0) close(fdin);
+
+    cout << "[outputvm] " << ctxswh->size() << " regions in "
+         << clusters.size() << " clusters";
+    if (nformatted) cout << " (" << nformatted << " re-formatted)";
+    cout << endl;
+}
+
+/*
+ * Write the instruction-ID range of each extracted VM snippet, one
+ * "<begin> <end> <depth> <parent> <sd>" line each (begin/end inclusive,
+ * parent the line number of the enclosing region counting from 0, or -1),
+ * for 'slicer -r', which reads the first two fields.
+ */
+void outputregions(const RegionTree &tree, string fname)
+{
+    FILE* fp = fopen(fname.c_str(), "w");
+    if (!fp) {
+        cerr << "[outputregions] Failed to open " << fname << endl;
+        return;
+    }
+    fprintf(fp, "# begin end depth parent sd\n");
+    int maxdepth = -1;
+    for (auto &r : tree.regions()) {
+        fprintf(fp, "%d %d %d %d %llx\n", r.begin, r.end, r.depth, r.parent,
+                (unsigned long long)r.sd);
+        maxdepth = max(maxdepth, r.depth);
+    }
+    fclose(fp);
+    if (maxdepth > 0) {
+        cout << "[outputregions] VM regions nest " << maxdepth + 1 << " levels deep\n";
+    }
+}
+
+/*
+ * For each trace ID in ids, print the regions containing it from the
+ * innermost outwards, as line numbers of vmregions.txt (counting from 0).
+ */
+void printregionsat(const RegionTree &tree, const vector<int> &ids)
+{
+    for (int id : ids) {
+        cout << "[regions] " << id << ":";
+        int r = tree.innermost(id);
+        if (r < 0) cout << " not in a VM region";
+        for (; r >= 0; r = tree.regions()[r].parent) {
+            const RegionTree::Node &n = tree.regions()[r];
+            cout << " " << r << " [" << n.begin << "," << n.end << "]";
+        }
+        cout << endl;
+    }
+}
+
+/*
+ * Check if a string is hex ("0x...").
+ */
+bool ishex(const string &s)
+{
+    if (s.size() >= 2 && s[0] == '0' && (s[1] == 'x' || s[1] == 'X')) {
+        return true;
+    }
+    return false;
+}
+
+/*
+ * Open-addressing hash map (linear probing, power-of-two capacity, grown
+ * at 1/2 load). Entries are never removed; clear() drops them all.
  */
-map<uint64_t, list<FuncBody*>*>* buildFuncList(list<Inst>* L)
+static inline uint64_t mixhash(uint64_t k)
+{
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    return k;
+}
+
+static inline uint64_t mixhash(const pair<uint64_t, uint64_t> &k)
 {
-    auto* funcmap = new map<uint64_t, list<FuncBody*>*>;
-    stack<list<Inst>::iterator> stk;
+    return mixhash(k.first ^ mixhash(k.second));
+}
+
+template <typename Key, typename Val>
+class OpenMap {
+    vector<Key> keys;
+    vector<Val> vals;
+    vector<uint8_t> used;
+    size_t n;
 
-    for (auto it = L->begin(); it != L->end(); ++it) {
-        if (it->opcstr == "call") {
-            // push the iterator
-            stk.push(it);
-            // see if function is in the map
-            auto pos = funcmap->find(it->addrn);
-            if (pos == funcmap->end()) {
-                // parse call operand (hex) as 64-bit
-                uint64_t calladdr = stoull(it->oprs[0], nullptr, 16);
-                (*funcmap)[calladdr] = nullptr;
+    size_t slot(const Key &k) const
+    {
+        size_t mask = keys.size() - 1;
+        size_t i = mixhash(k) & mask;
+        while (used[i] && !(keys[i] == k)) i = (i + 1) & mask;
+        return i;
+    }
+
+    void grow()
+    {
+        vector<Key> ok;
+        vector<Val> ov;
+        vector<uint8_t> ou;
+        ok.swap(keys);
+        ov.swap(vals);
+        ou.swap(used);
+        keys.resize(ok.size() * 2);
+        vals.resize(ok.size() * 2);
+        used.assign(ok.size() * 2, 0);
+        for (size_t i = 0; i < ok.size(); ++i) {
+            if (!ou[i]) continue;
+            size_t j = slot(ok[i]);
+            keys[j] = ok[i];
+            vals[j] = ov[i];
+            used[j] = 1;
+        }
+    }
+
+public:
+    OpenMap() { clear(); }
+
+    void clear()
+    {
+        keys.assign(1024, Key());
+        vals.assign(1024, Val());
+        used.assign(1024, 0);
+        n = 0;
+    }
+
+    size_t size() const { return n; }
+
+    Val *find(const Key &k)
+    {
+        size_t i = slot(k);
+        return used[i] ? &vals[i] : nullptr;
+    }
+
+    // Inserts a value-initialized entry if k is absent
+    Val &operator[](const Key &k)
+    {
+        size_t i = slot(k);
+        if (!used[i]) {
+            if (2 * (n + 1) > keys.size()) {
+                grow();
+                i = slot(k);
             }
+            keys[i] = k;
+            vals[i] = Val();
+            used[i] = 1;
+            n++;
+        }
+        return vals[i];
+    }
+};
+
+/*
+ * Structures for a CFG of the traced code. Blocks and edges are static:
+ * each executed address belongs to one block however often it runs.
+ */
+struct BB {
+    vector<Inst> instvec;   // first execution of each instruction, operands dropped
+    uint64_t beginaddr;
+    uint64_t endaddr;
+    vector<int> out;        // indices into CFG::edges leaving the block
+    int ty;  // 1: end with jump; 2: no jump
+    uint64_t count;         // times the block was entered
+
+    BB() : beginaddr(0), endaddr(0), ty(0), count(0) {}
+    BB(uint64_t b, uint64_t e) : beginaddr(b), endaddr(e), ty(0), count(0) {}
+    BB(uint64_t b, uint64_t e, int t) : beginaddr(b), endaddr(e), ty(t), count(0) {}
+};
+
+/*
+ * Edge types: the instruction ending the source block.
+ */
+enum { EDGE_FALL = 0, EDGE_JUMP = 1, EDGE_CALL = 2, EDGE_RET = 3 };
+
+struct Edge {
+    int from;
+    int to;
+    bool jumped;    // branch taken (false: fall-through)
+    int ty;         // EDGE_*
+    uint64_t count; // times the edge was executed
+    uint64_t fromaddr;  // last instruction of the source block
+    uint64_t toaddr;    // first instruction of the target block
+
+    Edge() : from(0), to(0), jumped(false), ty(0), count(0),
+             fromaddr(0), toaddr(0) {}
+    Edge(uint64_t a1, uint64_t a2, int t, uint64_t c)
+        : from(0), to(0), jumped(false), ty(t), count(c),
+          fromaddr(a1), toaddr(a2) {}
+};
+
+// Block and position of a static instruction
+struct InstPos {
+    int bb = -1;
+    int pos = -1;
+};
+
+/*
+ * CFG built from one pass over the trace (addInst per instruction, then
+ * finish). Only static code is stored: blocks keyed by instruction address
+ * in an open-addressing map, edges keyed by (fromaddr, toaddr), so memory
+ * does not grow with trace length. A block is split when execution enters
+ * it anywhere but its head.
+ */
+class CFG {
+    vector<BB> bbs;
+    vector<Edge> edges;
+    OpenMap<uint64_t, InstPos> bbmap;               // address -> block, position
+    OpenMap<pair<uint64_t, uint64_t>, int> edgemap; // (fromaddr, toaddr) -> edge
+
+    // State of the streaming construction: where the previous instruction is
+    int curbb = -1;
+    int curpos = -1;
+    int curty = EDGE_FALL;      // edge type if the previous instruction leaves its block
+    bool curcond = false;       // ... a conditional jump
+    uint64_t curtarget = 0;     // ... with this direct target (0: indirect)
+    int entry = -1;
+
+    int newBB(const Inst &ins);
+    void appendInst(int b, const Inst &ins);
+    int splitBB(int b, int pos, uint64_t count);
+    void enterBB(int b, const Inst &ins);
+    void rebuildMap();
+
+public:
+    CFG() {}
+    CFG(list<Inst>* L);
+    void addInst(const Inst &ins);
+    void finish();
+    void checkConsist();
+    void showCFG();
+    void outputDot();
+    void outputSimpleDot();
+    void showTrace(list<Inst>* L);
+    void compressCFG();
+};
+
+CFG::CFG(list<Inst>* L)
+{
+    for (auto &ins : *L) {
+        addInst(ins);
+    }
+    finish();
+}
+
+int CFG::newBB(const Inst &ins)
+{
+    bbs.push_back(BB(ins.addrn, ins.addrn));
+    int b = (int)bbs.size() - 1;
+    appendInst(b, ins);
+    return b;
+}
+
+void CFG::appendInst(int b, const Inst &ins)
+{
+    Inst copy = ins;
+    for (int i = 0; i < 4; i++) copy.oprd[i] = nullptr;
+    copy.src.clear();
+    copy.dst.clear();
+    copy.src2.clear();
+    copy.dst2.clear();
+
+    BB &bb = bbs[b];
+    bb.instvec.push_back(copy);
+    bb.endaddr = ins.addrn;
+    bbmap[ins.addrn] = InstPos{b, (int)bb.instvec.size() - 1};
+}
+
+/*
+ * Move instructions [pos, end) of block b into a new block, linked to b by
+ * a fall-through edge. count is how many executions of b reached pos: all
+ * of them when a jump lands on pos, one fewer when the current execution
+ * is what leaves b early.
+ */
+int CFG::splitBB(int b, int pos, uint64_t count)
+{
+    bbs.push_back(BB());
+    int nb = (int)bbs.size() - 1;
+    BB &head = bbs[b], &tail = bbs[nb];
+
+    tail.instvec.assign(head.instvec.begin() + pos, head.instvec.end());
+    head.instvec.resize(pos);
+    tail.beginaddr = tail.instvec.front().addrn;
+    tail.endaddr = head.endaddr;
+    head.endaddr = head.instvec.back().addrn;
+    tail.count = count;
+    for (int i = 0; i < (int)tail.instvec.size(); ++i) {
+        bbmap[tail.instvec[i].addrn] = InstPos{nb, i};
+    }
+
+    // Edges out of the old block now leave from the tail
+    edges.push_back(Edge(head.endaddr, tail.beginaddr, EDGE_FALL, count));
+    edgemap[{head.endaddr, tail.beginaddr}] = (int)edges.size() - 1;
+    tail.out.swap(head.out);
+    head.out.assign(1, (int)edges.size() - 1);
+
+    if (curbb == b && curpos >= pos) {
+        curbb = nb;
+        curpos -= pos;
+    }
+    return nb;
+}
+
+/*
+ * Execution moves from the previous instruction to the head of block b.
+ */
+void CFG::enterBB(int b, const Inst &ins)
+{
+    if (curbb >= 0) {
+        uint64_t from = bbs[curbb].instvec[curpos].addrn;
+        int *e = edgemap.find({from, ins.addrn});
+        if (!e) {
+            Edge edge(from, ins.addrn, curty, 0);
+            edge.jumped = (curty != EDGE_FALL) &&
+                          (!curcond || curtarget == 0 || curtarget == ins.addrn);
+            edges.push_back(edge);
+            edgemap[{from, ins.addrn}] = (int)edges.size() - 1;
+            bbs[curbb].out.push_back((int)edges.size() - 1);
+            e = edgemap.find({from, ins.addrn});
+        }
+        edges[*e].count++;
+    } else {
+        entry = b;
+    }
+    bbs[b].count++;
+    curbb = b;
+    curpos = 0;
+}
+
+void CFG::addInst(const Inst &ins)
+{
+    bool fall = (curbb >= 0 && curty == EDGE_FALL);
+    InstPos *p = bbmap.find(ins.addrn);
+
+    if (p && fall && p->bb == curbb && p->pos == curpos + 1) {
+        // Straight on inside the current block
+        curpos++;
+    }
+    else if (!p && fall && curpos == (int)bbs[curbb].instvec.size() - 1 &&
+             bbs[curbb].out.empty()) {
+        // New code right after the end of the current block
+        appendInst(curbb, ins);
+        curpos++;
+    }
+    else {
+        // Leaving the current block: whatever follows must start a block
+        if (curbb >= 0 && curpos + 1 < (int)bbs[curbb].instvec.size()) {
+            splitBB(curbb, curpos + 1, bbs[curbb].count - 1);
+        }
+        int b;
+        p = bbmap.find(ins.addrn);
+        if (!p) {
+            b = newBB(ins);
+        } else if (p->pos != 0) {
+            b = splitBB(p->bb, p->pos, bbs[p->bb].count);
+        } else {
+            b = p->bb;
+        }
+        enterBB(b, ins);
+    }
+
+    // How the instruction just added leaves its block, if it does
+    curcond = false;
+    curtarget = 0;
+    if (ins.opcstr == "call") {
+        curty = EDGE_CALL;
+    } else if (ins.opcstr == "ret") {
+        curty = EDGE_RET;
+    } else if (ins.opcstr[0] == 'j') {
+        curty = EDGE_JUMP;
+        curcond = (ins.opcstr != "jmp");
+        if (!ins.oprs.empty() && ishex(ins.oprs[0])) {
+            curtarget = stoull(ins.oprs[0], nullptr, 16);
+        }
+    } else {
+        curty = EDGE_FALL;
+    }
+}
+
+/*
+ * Resolve edge endpoints to blocks and fill in BB::out and BB::ty.
+ */
+void CFG::finish()
+{
+    for (auto &bb : bbs) {
+        bb.out.clear();
+        const string &opc = bb.instvec.back().opcstr;
+        bb.ty = (opc[0] == 'j' || opc == "call" || opc == "ret") ? 1 : 2;
+    }
+    for (int i = 0; i < (int)edges.size(); ++i) {
+        Edge &e = edges[i];
+        e.from = bbmap.find(e.fromaddr)->bb;
+        e.to = bbmap.find(e.toaddr)->bb;
+        bbs[e.from].out.push_back(i);
+    }
+}
+
+void CFG::rebuildMap()
+{
+    bbmap.clear();
+    for (int b = 0; b < (int)bbs.size(); ++b) {
+        for (int i = 0; i < (int)bbs[b].instvec.size(); ++i) {
+            bbmap[bbs[b].instvec[i].addrn] = InstPos{b, i};
+        }
+    }
+}
+
+/*
+ * Merge straight-line chains: a block whose only successor has it as only
+ * predecessor absorbs that successor, across fall-throughs and plain
+ * jumps (not calls or returns). Call after finish().
+ */
+void CFG::compressCFG()
+{
+    vector<int> indeg(bbs.size(), 0);
+    for (auto &e : edges) indeg[e.to]++;
+    vector<bool> dead(bbs.size(), false), deadedge(edges.size(), false);
+
+    for (int a = 0; a < (int)bbs.size(); ++a) {
+        if (dead[a]) continue;
+        while (bbs[a].out.size() == 1) {
+            int ei = bbs[a].out[0];
+            int b = edges[ei].to;
+            if (b == a || b == entry || dead[b] || indeg[b] != 1 ||
+                edges[ei].ty == EDGE_CALL || edges[ei].ty == EDGE_RET) {
+                break;
+            }
+            BB &A = bbs[a], &B = bbs[b];
+            A.instvec.insert(A.instvec.end(), B.instvec.begin(), B.instvec.end());
+            A.endaddr = B.endaddr;
+            A.ty = B.ty;
+            A.out = B.out;
+            for (int o : A.out) edges[o].from = a;
+            B.instvec.clear();
+            B.out.clear();
+            dead[b] = true;
+            deadedge[ei] = true;
+        }
+    }
+
+    // Renumber the surviving blocks and edges
+    vector<int> newidx(bbs.size(), -1), newedge(edges.size(), -1);
+    vector<BB> nbbs;
+    for (int b = 0; b < (int)bbs.size(); ++b) {
+        if (dead[b]) continue;
+        newidx[b] = (int)nbbs.size();
+        nbbs.push_back(std::move(bbs[b]));
+    }
+    vector<Edge> nedges;
+    for (int i = 0; i < (int)edges.size(); ++i) {
+        if (deadedge[i]) continue;
+        newedge[i] = (int)nedges.size();
+        Edge e = edges[i];
+        e.from = newidx[e.from];
+        e.to = newidx[e.to];
+        nedges.push_back(e);
+    }
+    for (auto &bb : nbbs) {
+        for (auto &o : bb.out) o = newedge[o];
+    }
+    entry = (entry >= 0) ? newidx[entry] : -1;
+    bbs.swap(nbbs);
+    edges.swap(nedges);
+
+    edgemap.clear();
+    for (int i = 0; i < (int)edges.size(); ++i) {
+        edgemap[{edges[i].fromaddr, edges[i].toaddr}] = i;
+    }
+    rebuildMap();
+    curbb = -1;
+}
+
+/*
+ * Check that blocks, the address map and edges agree, and that every
+ * block other than the entry is entered as often as its in-edges run.
+ */
+void CFG::checkConsist()
+{
+    int errors = 0;
+    vector<uint64_t> incount(bbs.size(), 0);
+    for (auto &e : edges) {
+        if (bbs[e.from].instvec.back().addrn != e.fromaddr ||
+            bbs[e.to].instvec.front().addrn != e.toaddr) {
+            cout << "[cfg] edge " << hex << e.fromaddr << " -> " << e.toaddr
+                 << dec << " does not join block ends\n";
+            errors++;
+        }
+        incount[e.to] += e.count;
+    }
+    for (int b = 0; b < (int)bbs.size(); ++b) {
+        for (int i = 0; i < (int)bbs[b].instvec.size(); ++i) {
+            InstPos *p = bbmap.find(bbs[b].instvec[i].addrn);
+            if (!p || p->bb != b || p->pos != i) {
+                cout << "[cfg] address map wrong for " << bbs[b].instvec[i].addr << endl;
+                errors++;
+            }
+        }
+        if (b != entry && incount[b] != bbs[b].count) {
+            cout << "[cfg] block " << b << " entered " << bbs[b].count
+                 << " times, in-edges ran " << incount[b] << " times\n";
+            errors++;
+        }
+    }
+    cout << "[cfg] " << bbs.size() << " blocks, " << edges.size() << " edges, "
+         << errors << " inconsistencies\n";
+}
+
+void CFG::showCFG()
+{
+    for (int b = 0; b < (int)bbs.size(); ++b) {
+        BB &bb = bbs[b];
+        cout << "BB" << b << " [" << hex << bb.beginaddr << ", " << bb.endaddr
+             << "]" << dec << " x" << bb.count << endl;
+        for (auto &ins : bb.instvec) {
+            cout << "    " << ins.addr << " " << ins.assembly << endl;
         }
-        else if (it->opcstr == "ret") {
-            if (!stk.empty()) {
-                stk.pop();
-            }
+        for (int o : bb.out) {
+            cout << "    -> BB" << edges[o].to << " x" << edges[o].count
+                 << (edges[o].jumped ? " (taken)" : "") << endl;
         }
     }
-    return funcmap;
 }
 
-/*
- * Print only the keys in the function map.
- */
-void printFuncmap(map<uint64_t, list<FuncBody*>*>* funcmap)
+// Quote a string for a dot label
+static string dotescape(const string &s)
 {
-    for (auto &kv : *funcmap) {
-        cout << hex << kv.first << endl;
+    string r;
+    for (char c : s) {
+        if (c == '"' || c == '\\') r += '\\';
+        r += c;
+    }
+    return r;
+}
+
+static const char *edgestyle(const Edge &e)
+{
+    switch (e.ty) {
+    case EDGE_CALL: return ", style=dashed";
+    case EDGE_RET:  return ", style=dotted";
+    default:        return e.jumped ? "" : ", color=gray";
     }
 }
 
 /*
- * Build a map (mnemonic -> unique int).
+ * Write cfg.dot: one box per block listing its instructions, edges
+ * labelled with their execution counts.
  */
-map<string,int>* buildOpcodeMap(list<Inst>* L)
+void CFG::outputDot()
 {
-    auto* mp = new map<string,int>;
-    for (auto &ins : *L) {
-        if (mp->find(ins.opcstr) == mp->end()) {
-            (*mp)[ins.opcstr] = (int)mp->size() + 1;
+    FILE* fp = fopen("cfg.dot", "w");
+    if (!fp) {
+        cerr << "[outputDot] Failed to open cfg.dot\n";
+        return;
+    }
+    fprintf(fp, "digraph cfg {\n    node [shape=box, fontname=\"monospace\"];\n");
+    for (int b = 0; b < (int)bbs.size(); ++b) {
+        fprintf(fp, "    bb%d [label=\"", b);
+        for (auto &ins : bbs[b].instvec) {
+            fprintf(fp, "%s %s\\l", ins.addr.c_str(), dotescape(ins.assembly).c_str());
         }
+        fprintf(fp, "\"];\n");
     }
-    return mp;
+    for (auto &e : edges) {
+        fprintf(fp, "    bb%d -> bb%d [label=\"%llu\"%s];\n", e.from, e.to,
+                (unsigned long long)e.count, edgestyle(e));
+    }
+    fprintf(fp, "}\n");
+    fclose(fp);
 }
 
 /*
- * Lookup numeric opcode from a mnemonic (returns 0 if not found).
+ * Write cfg.simple.dot: blocks as address ranges with entry counts only.
  */
-int getOpc(const string &s, map<string,int>* m)
+void CFG::outputSimpleDot()
 {
-    auto it = m->find(s);
-    if (it != m->end()) {
-        return it->second;
+    FILE* fp = fopen("cfg.simple.dot", "w");
+    if (!fp) {
+        cerr << "[outputSimpleDot] Failed to open cfg.simple.dot\n";
+        return;
     }
-    return 0;
+    fprintf(fp, "digraph cfg {\n");
+    for (int b = 0; b < (int)bbs.size(); ++b) {
+        fprintf(fp, "    bb%d [label=\"%llx-%llx\\nx%llu\"];\n", b,
+                (unsigned long long)bbs[b].beginaddr,
+                (unsigned long long)bbs[b].endaddr,
+                (unsigned long long)bbs[b].count);
+    }
+    for (auto &e : edges) {
+        fprintf(fp, "    bb%d -> bb%d [label=\"%llu\"%s];\n", e.from, e.to,
+                (unsigned long long)e.count, edgestyle(e));
+    }
+    fprintf(fp, "}\n");
+    fclose(fp);
 }
 
 /*
- * Check if integer opcode i is in the jump set.
+ * Print the trace as the sequence of blocks it runs through, with runs of
+ * the same block collapsed to "BBn xk".
  */
-bool isjump(int i, set<int>* jumpset)
+void CFG::showTrace(list<Inst>* L)
 {
-    return (jumpset->find(i) != jumpset->end());
+    int last = -1;
+    uint64_t run = 0;
+    for (auto &ins : *L) {
+        InstPos *p = bbmap.find(ins.addrn);
+        if (!p || p->pos != 0) continue;
+        if (p->bb == last) {
+            run++;
+            continue;
+        }
+        if (last >= 0) cout << "BB" << last << " x" << run << endl;
+        last = p->bb;
+        run = 1;
+    }
+    if (last >= 0) cout << "BB" << last << " x" << run << endl;
 }
 
 /*
- * Count how many indirect jumps by checking if operand[0] is not IMM.
+ * Dispatcher detection. One pass over the trace records, for every
+ * indirect jmp/call and every ret, which address executed next; the
+ * (site, target) histogram lives in a single OpenMap. Sites are ranked by
+ * fan-out (distinct targets), then by execution count, and the targets of
+ * the top site are written to handlers.txt as handler entry points.
+ * Returns the dispatcher's address, or 0 if the trace has no indirect
+ * branches; entries, if given, receives the handler addresses in the
+ * order of handlers.txt.
  */
-void countindjumps(list<Inst>* L)
+struct IndSite {
+    uint64_t addr;
+    string opcstr;
+    string oprs;
+    uint64_t execs = 0;
+    vector<uint64_t> targets;   // distinct, in first-seen order
+};
+
+static bool isindirect(const Inst &ins)
 {
-    int indjumpnum = 0;
+    if (ins.opcstr == "ret") return true;
+    if (ins.opcstr != "call" && !isjump(ins.opc, jmpset)) return false;
+    return ins.oprd[0] && ins.oprd[0]->ty != OperandType::IMM;
+}
+
+uint64_t finddispatcher(list<Inst>* L, string fname, vector<uint64_t>* entries = nullptr)
+{
+    OpenMap<uint64_t, int> siteidx;                 // site addr -> sites index
+    OpenMap<pair<uint64_t, uint64_t>, uint64_t> hist;   // (site, target) -> count
+    vector<IndSite> sites;
+
+    const Inst *pending = nullptr;
     for (auto &ins : *L) {
-        if (isjump(ins.opc, jmpset)) {
-            // If operand[0] is not IMM => indirect jump
-            if (ins.oprd[0]->ty != OperandType::IMM) {
-                ++indjumpnum;
-                cout << ins.addr << "\t" << ins.opcstr << " " << ins.oprs[0] << endl;
+        if (pending) {
+            int &idx = siteidx[pending->addrn];
+            if (idx == 0) {
+                IndSite ns;
+                ns.addr = pending->addrn;
+                ns.opcstr = pending->opcstr;
+                ns.oprs = pending->oprnum ? pending->oprs[0] : "";
+                sites.push_back(ns);
+                idx = (int)sites.size();
             }
+            IndSite &s = sites[idx - 1];
+            s.execs++;
+            uint64_t &c = hist[make_pair(pending->addrn, ins.addrn)];
+            if (c++ == 0) s.targets.push_back(ins.addrn);
         }
+        pending = isindirect(ins) ? &ins : nullptr;
     }
-    cout << "number of indirect jumps: " << indjumpnum << endl;
+
+    if (sites.empty()) {
+        cout << "[dispatcher] no indirect branches in trace\n";
+        return 0;
+    }
+
+    vector<int> rank(sites.size());
+    for (size_t i = 0; i < rank.size(); ++i) rank[i] = (int)i;
+    sort(rank.begin(), rank.end(), [&](int a, int b) {
+        size_t fa = sites[a].targets.size(), fb = sites[b].targets.size();
+        if (fa != fb) return fa > fb;
+        return sites[a].execs > sites[b].execs;
+    });
+
+    cout << "[dispatcher] indirect branch sites by fan-out:\n";
+    for (size_t i = 0; i < rank.size() && i < 10; ++i) {
+        IndSite &s = sites[rank[i]];
+        cout << hex << "  0x" << s.addr << dec << "\t" << s.opcstr << " " << s.oprs
+             << "\ttargets " << s.targets.size() << "\texecs " << s.execs << endl;
+    }
+
+    IndSite &d = sites[rank[0]];
+    vector<pair<uint64_t, uint64_t>> handlers;
+    for (uint64_t t : d.targets) {
+        handlers.push_back(make_pair(t, *hist.find(make_pair(d.addr, t))));
+    }
+    sort(handlers.begin(), handlers.end(),
+         [](const pair<uint64_t, uint64_t> &a, const pair<uint64_t, uint64_t> &b) {
+             return a.second != b.second ? a.second > b.second : a.first < b.first;
+         });
+
+    if (entries) {
+        for (auto &h : handlers) entries->push_back(h.first);
+    }
+
+    FILE *fp = fopen(fname.c_str(), "w");
+    if (!fp) {
+        cerr << "[dispatcher] Failed to open " << fname << endl;
+        return d.addr;
+    }
+    fprintf(fp, "# dispatcher 0x%llx %s %s targets %llu execs %llu\n",
+            (unsigned long long)d.addr, d.opcstr.c_str(), d.oprs.c_str(),
+            (unsigned long long)d.targets.size(), (unsigned long long)d.execs);
+    for (auto &h : handlers) {
+        fprintf(fp, "0x%llx %llu\n",
+                (unsigned long long)h.first, (unsigned long long)h.second);
+    }
+    fclose(fp);
+    cout << "[dispatcher] 0x" << hex << d.addr << dec << ", "
+         << handlers.size() << " handler entries written to " << fname << endl;
+    return d.addr;
 }
 
 /*
- * Simple peephole optimization that removes canceling pairs
- * (push/pop same, add/sub same, inc/dec same, etc.).
- * 
- * In 64-bit, there's no pushad/popad, so we omit them.
+ * Virtual instruction pointer recovery. Candidates are byte/word loads
+ * through a base register ([r] or [r+disp]); the VIP fetch is the one
+ * executed about once per dispatch whose address mostly advances by a
+ * small step (1..16 bytes) from its previous execution. The location is
+ * the base register, or the memory slot it was reloaded from each time if
+ * the VM keeps the VIP in memory. A second pass then emits one
+ * "<vip> <opcode> <handler>" line per dispatch: vip is the fetched
+ * address, the opcode is read from the destination register after the
+ * fetch, and the handler is the dispatcher's next target.
  */
-void peephole(list<Inst>* L)
+struct VipSite {
+    uint64_t addr;
+    string base;
+    string slot;            // where base was loaded from, if always the same
+    bool sameslot = true;
+    uint64_t execs = 0;
+    uint64_t steps = 0;     // executions 1..16 bytes past the previous one
+    uint64_t lastaddr = 0;
+};
+
+static const char *ctxregnames[8][4] = {
+    {"rax", "eax", "ax", "al"}, {"rbx", "ebx", "bx", "bl"},
+    {"rcx", "ecx", "cx", "cl"}, {"rdx", "edx", "dx", "dl"},
+    {"rsi", "esi", "si", "sil"}, {"rdi", "edi", "di", "dil"},
+    {"rsp", "esp", "sp", "spl"}, {"rbp", "ebp", "bp", "bpl"},
+};
+
+// Index of a register in Inst::ctxreg, or -1
+static int ctxindex(const string &reg)
 {
-    auto it = L->begin();
-    while (it != L->end()) {
-        auto nxt = std::next(it);
-        if (nxt == L->end()) {
-            break;
-        }
-        bool erased = false;
-
-        // Check pairs
-        if ((it->opcstr == "push" && nxt->opcstr == "pop"
-             && !it->oprs.empty() && !nxt->oprs.empty()
-             && it->oprs[0] == nxt->oprs[0]) )
-        {
-            nxt = L->erase(nxt);
-            it  = L->erase(it);
-            erased = true;
-            if (it != L->begin() && it != L->end()) {
-                --it;
-            }
-        }
-        else if ((it->opcstr == "pop" && nxt->opcstr == "push"
-                  && !it->oprs.empty() && !nxt->oprs.empty()
-                  && it->oprs[0] == nxt->oprs[0]) )
-        {
-            nxt = L->erase(nxt);
-            it  = L->erase(it);
-            erased = true;
-            if (it != L->begin() && it != L->end()) {
-                --it;
-            }
-        }
-        else if ((it->opcstr == "add" && nxt->opcstr == "sub"
-                  && it->oprs.size() == 2 && nxt->oprs.size() == 2
-                  && it->oprs[0] == nxt->oprs[0]
-                  && it->oprs[1] == nxt->oprs[1]) )
-        {
-            nxt = L->erase(nxt);
-            it  = L->erase(it);
-            erased = true;
-            if (it != L->begin() && it != L->end()) {
-                --it;
-            }
+    for (int i = 0; i < 8; ++i) {
+        for (int j = 0; j < 4; ++j) {
+            if (reg == ctxregnames[i][j]) return i;
         }
-        else if ((it->opcstr == "sub" && nxt->opcstr == "add"
-                  && it->oprs.size() == 2 && nxt->oprs.size() == 2
-                  && it->oprs[0] == nxt->oprs[0]
-                  && it->oprs[1] == nxt->oprs[1]) )
-        {
-            nxt = L->erase(nxt);
-            it  = L->erase(it);
-            erased = true;
-            if (it != L->begin() && it != L->end()) {
-                --it;
+    }
+    return -1;
+}
+
+// Width of a byte/word memory operand, else 0 (the parser records 64 for
+// every memory operand, so this reads the size keyword)
+static int fetchbits(const string &opr)
+{
+    if (opr.compare(0, 9, "byte ptr ") == 0) return 8;
+    if (opr.compare(0, 9, "word ptr ") == 0) return 16;
+    return 0;
+}
+
+static bool isfetch(const Inst &ins)
+{
+    return ins.raddr && ins.oprnum == 2 && ins.oprd[0] && ins.oprd[1]
+        && ins.oprd[0]->ty == OperandType::REG
+        && ins.oprd[1]->ty == OperandType::MEM
+        && (ins.oprd[1]->tag == 2 || ins.oprd[1]->tag == 4)
+        && fetchbits(ins.oprs[1]) != 0;
+}
+
+void findvip(list<Inst>* L, uint64_t dispatcher, string fname)
+{
+    OpenMap<uint64_t, int> siteidx;
+    vector<VipSite> sites;
+    map<string, string> lastsrc;    // register -> memory operand it was loaded from
+    uint64_t dispatches = 0;
+
+    for (auto &ins : *L) {
+        if (ins.addrn == dispatcher) dispatches++;
+        if (isfetch(ins)) {
+            int &idx = siteidx[ins.addrn];
+            if (idx == 0) {
+                VipSite vs;
+                vs.addr = ins.addrn;
+                vs.base = ins.oprd[1]->field[0];
+                vs.slot = lastsrc[vs.base];
+                sites.push_back(vs);
+                idx = (int)sites.size();
             }
-        }
-        else if ((it->opcstr == "inc" && nxt->opcstr == "dec"
-                  && !it->oprs.empty() && !nxt->oprs.empty()
-                  && it->oprs[0] == nxt->oprs[0]) )
-        {
-            nxt = L->erase(nxt);
-            it  = L->erase(it);
-            erased = true;
-            if (it != L->begin() && it != L->end()) {
-                --it;
+            VipSite &vs = sites[idx - 1];
+            if (vs.execs && ins.raddr > vs.lastaddr && ins.raddr - vs.lastaddr <= 16) {
+                vs.steps++;
             }
+            if (lastsrc[vs.base] != vs.slot) vs.sameslot = false;
+            vs.lastaddr = ins.raddr;
+            vs.execs++;
         }
-        else if ((it->opcstr == "dec" && nxt->opcstr == "inc"
-                  && !it->oprs.empty() && !nxt->oprs.empty()
-                  && it->oprs[0] == nxt->oprs[0]) )
-        {
-            nxt = L->erase(nxt);
-            it  = L->erase(it);
-            erased = true;
-            if (it != L->begin() && it != L->end()) {
-                --it;
-            }
+        if (ins.oprnum >= 1 && ins.oprd[0] && ins.oprd[0]->ty == OperandType::REG
+            && ins.opcstr != "cmp" && ins.opcstr != "test" && ins.opcstr != "push") {
+            bool reload = ins.opcstr == "mov" && ins.oprnum == 2 && ins.oprd[1]
+                          && ins.oprd[1]->ty == OperandType::MEM;
+            lastsrc[ins.oprd[0]->field[0]] = reload ? ins.oprs[1] : "";
         }
+    }
 
-        if (!erased) {
-            ++it;
+    // Best stepping fetch among those run about once per dispatch
+    int best = -1;
+    for (size_t i = 0; i < sites.size(); ++i) {
+        VipSite &vs = sites[i];
+        if (vs.steps == 0 || vs.execs * 2 < dispatches || vs.execs > dispatches * 2 + 1) continue;
+        if (best < 0 || vs.steps > sites[best].steps
+            || (vs.steps == sites[best].steps && vs.execs < sites[best].execs)) {
+            best = (int)i;
         }
     }
-}
+    if (best < 0) {
+        cout << "[vip] no fetch stepping once per dispatch found\n";
+        return;
+    }
+    VipSite &v = sites[best];
+    string location = (v.sameslot && !v.slot.empty()) ? v.slot : v.base;
+    cout << "[vip] " << location << ", fetched at 0x" << hex << v.addr << dec
+         << " (" << v.steps << " of " << v.execs << " executions step forward)\n";
 
-void peephole(list<Inst>* L)
-{
-    auto it = L->begin();
-    while (it != L->end()) {
-        auto nxt = std::next(it);
-        if (nxt == L->end()) {
-            break;
-        }
-        bool erased = false;
-
-        // Check pairs (push/pop, add/sub, inc/dec)
-        if ((it->opcstr == "push" && nxt->opcstr == "pop"
-             && !it->oprs.empty() && !nxt->oprs.empty()
-             && it->oprs[0] == nxt->oprs[0]) )
-        {
-            nxt = L->erase(nxt);
-            it  = L->erase(it);
-            erased = true;
-            if (it != L->begin() && it != L->end()) {
-                --it;
-            }
-        }
-        else if ((it->opcstr == "pop" && nxt->opcstr == "push"
-                  && !it->oprs.empty() && !nxt->oprs.empty()
-                  && it->oprs[0] == nxt->oprs[0]) )
-        {
-            nxt = L->erase(nxt);
-            it  = L->erase(it);
-            erased = true;
-            if (it != L->begin() && it != L->end()) {
-                --it;
-            }
+    FILE *fp = fopen(fname.c_str(), "w");
+    if (!fp) {
+        cerr << "[vip] Failed to open " << fname << endl;
+        return;
+    }
+    fprintf(fp, "# vip %s fetch 0x%llx dispatcher 0x%llx\n", location.c_str(),
+            (unsigned long long)v.addr, (unsigned long long)dispatcher);
+
+    // Single pass: fetch -> (vip, opcode from the next instruction) -> handler
+    enum { IDLE, FETCHED, HAVEOPC, DISPATCH } state = IDLE;
+    uint64_t vip = 0, opc = 0;
+    bool opcknown = false;
+    int dreg = -1;
+    uint64_t mask = 0;
+    uint64_t ntuples = 0;
+    for (auto &ins : *L) {
+        if (state == FETCHED) {
+            opcknown = dreg >= 0;
+            opc = opcknown ? (ins.ctxreg[dreg] & mask) : 0;
+            state = HAVEOPC;
         }
-        else if ((it->opcstr == "add" && nxt->opcstr == "sub"
-                  && it->oprs.size() == 2 && nxt->oprs.size() == 2
-                  && it->oprs[0] == nxt->oprs[0]
-                  && it->oprs[1] == nxt->oprs[1]) )
-        {
-            nxt = L->erase(nxt);
-            it  = L->erase(it);
-            erased = true;
-            if (it != L->begin() && it != L->end()) {
-                --it;
+        else if (state == DISPATCH) {
+            if (opcknown) {
+                fprintf(fp, "%llx %llx %llx\n", (unsigned long long)vip,
+                        (unsigned long long)opc, (unsigned long long)ins.addrn);
             }
-        }
-        else if ((it->opcstr == "sub" && nxt->opcstr == "add"
-                  && it->oprs.size() == 2 && nxt->oprs.size() == 2
-                  && it->oprs[0] == nxt->oprs[0]
-                  && it->oprs[1] == nxt->oprs[1]) )
-        {
-            nxt = L->erase(nxt);
-            it  = L->erase(it);
-            erased = true;
-            if (it != L->begin() && it != L->end()) {
-                --it;
+            else {
+                fprintf(fp, "%llx ? %llx\n", (unsigned long long)vip,
+                        (unsigned long long)ins.addrn);
             }
+            ntuples++;
+            state = IDLE;
         }
-        else if ((it->opcstr == "inc" && nxt->opcstr == "dec"
-                  && !it->oprs.empty() && !nxt->oprs.empty()
-                  && it->oprs[0] == nxt->oprs[0]) )
-        {
-            nxt = L->erase(nxt);
-            it  = L->erase(it);
-            erased = true;
-            if (it != L->begin() && it != L->end()) {
-                --it;
-            }
+
+        if (ins.addrn == v.addr) {
+            vip = ins.raddr;
+            dreg = ctxindex(ins.oprd[0]->field[0]);
+            mask = fetchbits(ins.oprs[1]) == 8 ? 0xff : 0xffff;
+            state = FETCHED;
         }
-        else if ((it->opcstr == "dec" && nxt->opcstr == "inc"
-                  && !it->oprs.empty() && !nxt->oprs.empty()
-                  && it->oprs[0] == nxt->oprs[0]) )
-        {
-            nxt = L->erase(nxt);
-            it  = L->erase(it);
-            erased = true;
-            if (it != L->begin() && it != L->end()) {
-                --it;
-            }
+        else if (ins.addrn == dispatcher && state == HAVEOPC) {
+            state = DISPATCH;
         }
+    }
+    fclose(fp);
+    cout << "[vip] " << ntuples << " bytecode tuples written to " << fname << endl;
+}
+
+/*
+ * Handler-level trace. Every dispatch starts one entry covering the
+ * instructions from the handler's first instruction up to the next
+ * dispatch (the dispatcher block included). Entries are written as
+ *   <handler id> <first trace id> <offset> <instructions> [<value> ...]
+ * where the handler id indexes the "#handler <id> <address>" header lines,
+ * the trace ID is Inst::id of the entry's first instruction (it does not
+ * count skipped lines, so it is not a line number), the offset is the hex
+ * byte offset of that instruction's line in the trace file ("-" if it came
+ * from a fold record), and the values are the first MAXKEYOPS register
+ * loads of the entry (the loaded value is read from the register after the
+ * load, so only loads into rax..rbp are covered). Instructions before the
+ * first dispatch are not written.
+ */
+#define MAXKEYOPS 4
+
+void outputhandlertrace(list<Inst>* L, uint64_t dispatcher,
+                        const vector<uint64_t> &entries, string fname)
+{
+    FILE *fp = fopen(fname.c_str(), "w");
+    if (!fp) {
+        cerr << "[handlers] Failed to open " << fname << endl;
+        return;
+    }
+    OpenMap<uint64_t, int> hid;     // handler address -> id + 1
+    for (size_t i = 0; i < entries.size(); ++i) {
+        hid[entries[i]] = (int)i + 1;
+        fprintf(fp, "#handler %zu %llx\n", i, (unsigned long long)entries[i]);
+    }
+
+    int curid = -1, firstid = 0, ninst = 0;
+    uint64_t firstoff = UINT64_MAX;
+    vector<uint64_t> keys;
+    int loadreg = -1;               // ctxreg index loaded by the previous instruction
+    uint64_t nentries = 0, ninsts = 0;
+    bool afterdispatch = false;
+
+    auto flush = [&]() {
+        if (curid < 0) return;
+        fprintf(fp, "%d %d ", curid, firstid);
+        if (firstoff == UINT64_MAX) fprintf(fp, "-");
+        else fprintf(fp, "%llx", (unsigned long long)firstoff);
+        fprintf(fp, " %d", ninst);
+        for (uint64_t v : keys) fprintf(fp, " %llx", (unsigned long long)v);
+        fprintf(fp, "\n");
+        nentries++;
+    };
 
-        // Check for 7 consecutive push instructions
-        else if (std::distance(it, L->end()) >= 7 && chkpush(it, std::next(it, 7))) {
-            auto it7 = std::next(it, 7);  // Iterator to the 7th instruction
-            cout << "[peephole] Found 7 consecutive pushes from "
-                 << it->id << " to " << std::prev(it7)->id << endl;
-            it = L->erase(it, it7);       // Remove the 7 push instructions
-            erased = true;
+    for (auto &ins : *L) {
+        ninsts++;
+        if (loadreg >= 0 && curid >= 0 && keys.size() < MAXKEYOPS) {
+            keys.push_back(ins.ctxreg[loadreg]);
         }
+        loadreg = -1;
 
-        // Check for 7 consecutive pop instructions
-        else if (std::distance(it, L->end()) >= 7 && chkpop(it, std::next(it, 7))) {
-            auto it7 = std::next(it, 7);  // Iterator to the 7th instruction
-            cout << "[peephole] Found 7 consecutive pops from "
-                 << it->id << " to " << std::prev(it7)->id << endl;
-            it = L->erase(it, it7);       // Remove the 7 pop instructions
-            erased = true;
+        if (afterdispatch) {
+            flush();
+            int *h = hid.find(ins.addrn);
+            curid = h ? *h - 1 : -1;
+            firstid = ins.id;
+            firstoff = ins.off;
+            ninst = 0;
+            keys.clear();
+            afterdispatch = false;
         }
+        ninst++;
 
-        if (!erased) {
-            ++it;
+        if (ins.raddr && ins.oprnum == 2 && ins.oprd[0] && ins.oprd[1]
+            && ins.oprd[0]->ty == OperandType::REG && ins.oprd[1]->ty == OperandType::MEM) {
+            loadreg = ctxindex(ins.oprd[0]->field[0]);
         }
+        if (ins.addrn == dispatcher) afterdispatch = true;
     }
+    flush();
+    fclose(fp);
+    cout << "[handlers] " << nentries << " handler executions for " << ninsts
+         << " instructions written to " << fname << endl;
 }
 
-
-
-
-
 /*
- * A structure capturing a block of instructions (push or pop) we consider a context save/restore.
+ * Loop detection. A backward edge is a jmp/jcc whose successor lies at or
+ * below it; its target is a loop header. Iterations of one loop instance
+ * are consecutive arrivals at the header through backward edges, so an
+ * instance is the chain of positions (index in the trace) where each
+ * iteration starts; the last one is the start of the final, possibly
+ * partial, iteration. Arriving at the header any other way starts a new
+ * instance.
  */
-struct ctxswitch {
-    list<Inst>::iterator begin;
-    list<Inst>::iterator end;
-    uint64_t sd;  // stack depth or pointer (64-bit)
+struct LoopRun {
+    uint64_t header;
+    int firstid;            // trace ID at the start of the first iteration
+    vector<int> starts;     // positions; starts.size() - 1 complete iterations
+
+    int iterations() const { return (int)starts.size() - 1; }
 };
 
-/*
- * Global lists storing context saves and restores, then pairing them up.
- */
-list<ctxswitch> ctxsave;
-list<ctxswitch> ctxrestore;
-list<pair<ctxswitch, ctxswitch>> ctxswh;
+static int loopmin = 4;     // iterations needed to summarize an instance
 
-/*
- * Check if a string is one of our recognized 64-bit regs (rax, rbx, etc.).
- * If your code only needs minimal GPR set, keep it short.
- * If you want r8..r15, add them too.
- */
-bool isreg(const string &s)
+vector<LoopRun> findloops(list<Inst>* L)
 {
-    static const set<string> gprs64 = {
-        "rax","rbx","rcx","rdx","rsi","rdi","rbp","rsp"
-	,"r8","r9","r10","r11","r12","r13","r14","r15"
-    };
-    return (gprs64.find(s) != gprs64.end());
+    OpenMap<uint64_t, pair<int,int>> lastseen;  // address -> (position + 1, id)
+    OpenMap<uint64_t, int> active;              // header -> loops index + 1
+    vector<LoopRun> loops;
+
+    int pos = 0;
+    const Inst *prev = nullptr;
+    for (auto &ins : *L) {
+        pair<int,int> &seen = lastseen[ins.addrn];
+        if (prev && seen.first && isjump(prev->opc, jmpset) && ins.addrn <= prev->addrn) {
+            int &a = active[ins.addrn];
+            if (a && loops[a - 1].starts.back() == seen.first - 1) {
+                loops[a - 1].starts.push_back(pos);
+            }
+            else {
+                LoopRun lr;
+                lr.header = ins.addrn;
+                lr.firstid = seen.second;
+                lr.starts = {seen.first - 1, pos};
+                loops.push_back(lr);
+                a = (int)loops.size();
+            }
+        }
+        seen = make_pair(pos + 1, ins.id);
+        prev = &ins;
+        pos++;
+    }
+    return loops;
 }
 
 /*
- * Check if [i1..i2) are all "push <reg>", and no repeated regs.
+ * Per header: instances, iterations and trip lengths (in instructions).
  */
-bool chkpush(list<Inst>::iterator i1, list<Inst>::iterator i2)
+void printloops(const vector<LoopRun> &loops)
 {
-    int opcpush = getOpc("push", instenum);
-    for (auto it = i1; it != i2; ++it) {
-        if (it->opc != opcpush) return false;
-        if (it->oprs.empty())   return false;
-        if (!isreg(it->oprs[0])) {
-            return false;
+    struct Stat { int instances = 0; uint64_t iters = 0, total = 0; int mintrip = INT32_MAX, maxtrip = 0; };
+    map<uint64_t, Stat> stats;
+    for (auto &lr : loops) {
+        Stat &st = stats[lr.header];
+        st.instances++;
+        st.iters += lr.iterations();
+        for (size_t k = 0; k + 1 < lr.starts.size(); ++k) {
+            int trip = lr.starts[k + 1] - lr.starts[k];
+            st.total += trip;
+            st.mintrip = min(st.mintrip, trip);
+            st.maxtrip = max(st.maxtrip, trip);
         }
     }
-    // ensure no repeated registers
-    set<string> used;
-    for (auto it = i1; it != i2; ++it) {
-        const string &rname = it->oprs[0];
-        if (!used.insert(rname).second) {
-            return false;
-        }
+    cout << "header\tinstances\titerations\ttrip min/avg/max\n";
+    for (auto &kv : stats) {
+        const Stat &st = kv.second;
+        cout << hex << kv.first << dec << "\t" << st.instances << "\t" << st.iters << "\t"
+             << st.mintrip << "/" << st.total / st.iters << "/" << st.maxtrip << endl;
     }
-    return true;
 }
 
 /*
- * Check if [i1..i2) are all "pop <reg>", and no repeated regs.
+ * Set FuncBody::loopn: each loop instance is counted in the innermost
+ * activation that was running when it started.
  */
-bool chkpop(list<Inst>::iterator i1, list<Inst>::iterator i2)
+void countloops(map<uint64_t, Func*>* funcmap, const vector<LoopRun> &loops)
 {
-    int opcpop = getOpc("pop", instenum);
-    for (auto it = i1; it != i2; ++it) {
-        if (it->opc != opcpop) return false;
-        if (it->oprs.empty())  return false;
-        if (!isreg(it->oprs[0])) {
-            return false;
+    vector<FuncBody*> bodies;
+    for (auto &kv : *funcmap) {
+        for (FuncBody *fb : kv.second->body) {
+            fb->loopn = 0;
+            bodies.push_back(fb);
         }
     }
-    set<string> used;
-    for (auto it = i1; it != i2; ++it) {
-        const string &rname = it->oprs[0];
-        if (!used.insert(rname).second) {
-            return false;
+    sort(bodies.begin(), bodies.end(),
+         [](FuncBody *a, FuncBody *b) { return a->start < b->start; });
+    for (auto &lr : loops) {
+        auto it = upper_bound(bodies.begin(), bodies.end(), lr.firstid,
+                              [](int id, FuncBody *fb) { return id < fb->start; });
+        while (it != bodies.begin()) {
+            --it;
+            if ((*it)->end >= lr.firstid) {
+                (*it)->loopn++;
+                break;
+            }
         }
     }
-    return true;
 }
 
-/*
- * Search the instruction list L and extract "VM" snippets:
- * sequences of 7 pushes or 7 pops in a row.
- */
-void vmextract(list<Inst>* L)
+// Iterations a and b of lr follow the same static path
+static bool sameiter(const vector<const Inst*> &v, const LoopRun &lr, size_t a, size_t b)
 {
-    // We'll look for exactly 7 consecutive pushes or pops.
-    // If you want a different count, change "7" to something else.
-    for (auto it = L->begin(); it != L->end(); ++it) {
-        // Ensure we have at least 7 instructions from [it..end).
-        if (std::distance(it, L->end()) < 7) {
-            break; // not enough instructions
-        }
-        auto it7 = std::next(it, 7);
-
-        // Check 7 pushes
-        if (chkpush(it, it7)) {
-            ctxswitch cs;
-            cs.begin = it;
-            cs.end   = it7;
-            // Assume ctxreg[6] is 'rsp' if your trace sets that
-            // For a real 64-bit code, it might be index 7 or so, adjust if needed
-            cs.sd    = it7->ctxreg[6];  // 64-bit stack pointer
-            ctxsave.push_back(cs);
-            cout << "[vmextract] push found:\n"
-                 << it->id << " " << it->addr << " " << it->assembly << endl;
-        }
-        // Check 7 pops
-        else if (chkpop(it, it7)) {
-            ctxswitch cs;
-            cs.begin = it;
-            cs.end   = it7;
-            cs.sd    = it->ctxreg[6];
-            ctxrestore.push_back(cs);
-            cout << "[vmextract] pop found:\n"
-                 << it->id << " " << it->addr << " " << it->assembly << endl;
-        }
-    }
-
-    // Pair up saves and restores by matching sd
-    for (auto &sv : ctxsave) {
-        for (auto &rs : ctxrestore) {
-            if (sv.sd == rs.sd) {
-                ctxswh.push_back({sv, rs});
-                // If you only want to pair each save with its first matching restore, 
-                // add a "break;" here
-            }
-        }
+    int len = lr.starts[a + 1] - lr.starts[a];
+    if (len != lr.starts[b + 1] - lr.starts[b]) return false;
+    for (int j = 0; j < len; ++j) {
+        if (v[lr.starts[a] + j]->addrn != v[lr.starts[b] + j]->addrn) return false;
     }
+    return true;
 }
 
 /*
- * Write the extracted VM snippets to separate files (vm1.txt, vm2.txt, etc.).
+ * Write the trace with every outermost loop instance of at least loopmin
+ * iterations summarized: a "#loop <header> <iterations>" comment, then
+ * each run of iterations that follow the same path as one "#fold" record
+ * (parseTrace expands it again; see printFoldLLSE). Iterations that differ
+ * from their neighbours, the final partial one and all other instructions
+ * are copied in the trace format, so the file reads back as the whole trace.
  */
-void outputvm(list<pair<ctxswitch, ctxswitch>>* ctxswh)
+void outputloopsummary(list<Inst>* L, const vector<LoopRun> &loops, string fname)
 {
-    int n = 1;
-    for (auto &pairCS : *ctxswh) {
-        auto i1 = pairCS.first.begin;
-        auto i2 = pairCS.second.end;
-        string vmfile = "vm" + to_string(n++) + ".txt";
-        FILE* fp = fopen(vmfile.c_str(), "w");
-        if (!fp) {
-            cerr << "[outputvm] Failed to open " << vmfile << endl;
+    vector<const LoopRun*> sel;
+    for (auto &lr : loops) {
+        if (lr.iterations() >= loopmin) sel.push_back(&lr);
+    }
+    sort(sel.begin(), sel.end(), [](const LoopRun *a, const LoopRun *b) {
+        if (a->starts.front() != b->starts.front()) return a->starts.front() < b->starts.front();
+        return a->starts.back() > b->starts.back();
+    });
+
+    FILE *fp = fopen(fname.c_str(), "w");
+    if (!fp) {
+        cerr << "[loops] Failed to open " << fname << endl;
+        return;
+    }
+    vector<const Inst*> v;
+    v.reserve(L->size());
+    for (auto &ins : *L) v.push_back(&ins);
+
+    int nsum = 0;
+    size_t next = 0;
+    for (size_t pos = 0; pos < v.size(); ) {
+        // instances starting inside the one just summarized are nested
+        while (next < sel.size() && sel[next]->starts.front() < (int)pos) next++;
+        if (next == sel.size() || sel[next]->starts.front() != (int)pos) {
+            printInstLLSE(fp, *v[pos++]);
             continue;
         }
-        // Dump instructions from [i1..i2)
-        for (auto it = i1; it != i2; ++it) {
-            fprintf(fp, "%s;%s;", it->addr.c_str(), it->assembly.c_str());
-            // print context registers
-            for (int j = 0; j < 8; ++j) {
-                fprintf(fp, "%llx,", (unsigned long long)it->ctxreg[j]);
+
+        const LoopRun &cur = *sel[next++];
+        nsum++;
+        fprintf(fp, "#loop %llx %d\n", (unsigned long long)cur.header, cur.iterations());
+        for (size_t k = 0; k < (size_t)cur.iterations(); ) {
+            size_t n = 1;
+            while (k + n < (size_t)cur.iterations() && sameiter(v, cur, k, k + n)) n++;
+            int len = cur.starts[k + 1] - cur.starts[k];
+            if (n == 1) {
+                for (int j = 0; j < len; ++j) printInstLLSE(fp, *v[cur.starts[k] + j]);
+            } else {
+                printFoldLLSE(fp, v, cur.starts[k], len, n);
             }
-            // print read/write addresses
-            fprintf(fp, "%llx,%llx\n",
-                    (unsigned long long)it->raddr,
-                    (unsigned long long)it->waddr);
+            k += n;
         }
-        fclose(fp);
+        pos = cur.starts.back();
     }
+    fclose(fp);
+    cout << "[loops] " << loops.size() << " loop instances, " << nsum
+         << " summarized in " << fname << endl;
 }
 
 /*
- * Check if a string is hex ("0x...").
+ * "vmextract runs": report maximal runs of consecutive push* and pop*
+ * instructions straight from the trace text, one line at a time, without
+ * building instructions. For each direction it prints the longest run
+ * (the first one if tied), a histogram of run lengths, and how often each
+ * set of operands occurred in runs of at least ctxrunlen. Memory is
+ * bounded by the longest run and the number of distinct sets.
  */
-bool ishex(const string &s)
-{
-    if (s.size() >= 2 && s[0] == '0' && (s[1] == 'x' || s[1] == 'X')) {
-        return true;
-    }
-    return false;
-}
+struct PushRuns {
+    const char *name;
+    vector<string> cur, longest;    // "addr: instruction" lines
+    vector<string> regs;            // operands of the current run
+    map<size_t, uint64_t> hist;     // run length -> runs
+    map<string, uint64_t> sets;     // sorted operand set -> runs
 
-/*
- * Structures for a CFG, if you wish to build/print it in 64-bit style.
- */
-struct Edge;
+    void add(const string &addr, const string &inst)
+    {
+        cur.push_back(addr + ": " + inst);
+        size_t sp = inst.find(' ');
+        regs.push_back(sp == string::npos ? inst : inst.substr(sp + 1));
+    }
 
-struct BB {
-    vector<Inst> instvec;
-    uint64_t beginaddr;
-    uint64_t endaddr;
-    vector<int> out;
-    int ty;  // 1: end with jump; 2: no jump
+    void close()
+    {
+        if (cur.empty()) return;
+        hist[cur.size()]++;
+        if ((int)cur.size() >= ctxrunlen) {
+            sort(regs.begin(), regs.end());
+            string key;
+            for (auto &r : regs) key += (key.empty() ? "" : ",") + r;
+            sets[key]++;
+        }
+        // Strictly longer, so the first of equal runs is kept
+        if (cur.size() > longest.size()) longest.swap(cur);
+        cur.clear();
+        regs.clear();
+    }
 
-    BB() : beginaddr(0), endaddr(0), ty(0) {}
-    BB(uint64_t b, uint64_t e) : beginaddr(b), endaddr(e), ty(0) {}
-    BB(uint64_t b, uint64_t e, int t) : beginaddr(b), endaddr(e), ty(t) {}
+    void report(const char *title, const char *plural)
+    {
+        cout << "\nMaximum consecutive " << plural << " found: " << longest.size() << endl;
+        if (!longest.empty()) {
+            cout << title << " Sequence:\n";
+            for (auto &l : longest) cout << l << endl;
+        }
+        cout << name << " run lengths:\n";
+        for (auto &kv : hist) cout << "  " << kv.first << "\t" << kv.second << endl;
+        if (!sets.empty()) {
+            cout << name << " operand sets in runs of " << ctxrunlen << " or more:\n";
+            for (auto &kv : sets) cout << "  " << kv.second << "\t" << kv.first << endl;
+        }
+    }
 };
 
-struct Edge {
-    int from;
-    int to;
-    bool jumped;
-    int ty;       
-    int count;
-    uint64_t fromaddr;
-    uint64_t toaddr;
+static string trim(const string &s)
+{
+    size_t b = s.find_first_not_of(" \t\r\n");
+    if (b == string::npos) return "";
+    size_t e = s.find_last_not_of(" \t\r\n");
+    return s.substr(b, e - b + 1);
+}
 
-    Edge() : from(0), to(0), jumped(false), ty(0), count(0),
-             fromaddr(0), toaddr(0) {}
-    Edge(uint64_t a1, uint64_t a2, int t, int c)
-        : from(0), to(0), jumped(false), ty(t), count(c),
-          fromaddr(a1), toaddr(a2) {}
-};
+int pushruns(const char *fname)
+{
+    FILE *fp = fopen(fname, "r");
+    if (!fp) {
+        cerr << "Open file error: " << fname << endl;
+        return 1;
+    }
+    setvbuf(fp, nullptr, _IOFBF, 1 << 20);
 
-class CFG {
-    vector<BB> bbs;
-    vector<Edge> edges;
-    map<uint64_t,int> bbmap;  // address -> index of BB, if used
+    PushRuns pushes, pops;
+    pushes.name = "push";
+    pops.name = "pop";
+    char *buf = nullptr;
+    size_t cap = 0;
+    ssize_t n;
+    while ((n = ::getline(&buf, &cap, fp)) > 0) {
+        const char *semi = (const char *)memchr(buf, ';', n);
+        if (!semi) continue;
+        const char *end = (const char *)memchr(semi + 1, ';', buf + n - semi - 1);
+        string inst = trim(string(semi + 1, end ? end : buf + n));
 
-public:
-    CFG() {}
-    CFG(list<Inst>* L);
-    void checkConsist();
-    void showCFG();
-    void outputDot();
-    void outputSimpleDot();
-    void showTrace(list<Inst>* L);
-    void compressCFG();
-};
+        if (inst.compare(0, 4, "push") == 0) {
+            pops.close();
+            pushes.add(trim(string((const char *)buf, semi)), inst);
+        }
+        else if (inst.compare(0, 3, "pop") == 0) {
+            pushes.close();
+            pops.add(trim(string((const char *)buf, semi)), inst);
+        }
+        else {
+            pushes.close();
+            pops.close();
+        }
+    }
+    free(buf);
+    fclose(fp);
+    pushes.close();
+    pops.close();
+
+    pushes.report("Push", "pushes");
+    pops.report("Pop", "pops");
+    return 0;
+}
 
 /*
  * Build opcode map, fill in numeric opcodes in Inst, build jump set.
@@ -619,14 +2272,108 @@ void preprocess(list<Inst>* L)
  */
 int main(int argc, char** argv)
 {
-    if (argc != 2) {
-        cerr << "usage: " << argv[0] << " <tracefile>\n";
+    // vmextract runs [-n <run length>] [tracefile]
+    if (argc >= 2 && string(argv[1]) == "runs") {
+        const char *fname = "instrace.txt";
+        for (int i = 2; i < argc; ++i) {
+            string arg = argv[i];
+            if (arg == "-n" && i + 1 < argc) {
+                ctxrunlen = atoi(argv[++i]);
+            }
+            else {
+                fname = argv[i];
+            }
+        }
+        if (ctxrunlen < 1) {
+            cerr << "usage: " << argv[0] << " runs [-n <run length>] [tracefile]\n"
+                 << "  -n  shortest run whose operand set is reported, at least 1 (default 7)\n";
+            return 1;
+        }
+        return pushruns(fname);
+    }
+
+    const char* tracefile = nullptr;
+    bool cfgout = false;
+    bool dispout = false;
+    bool vipout = false;
+    bool htraceout = false;
+    int nwriters = 1;
+    vector<string> sigs;
+    bool funcout = false;
+    bool loopout = false;
+    vector<int> regionids;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "-n" && i + 1 < argc) {
+            ctxrunlen = atoi(argv[++i]);
+        }
+        else if (arg == "-R" && i + 1 < argc) {
+            // comma-separated register list
+            ctxregs.clear();
+            istringstream regbuf(argv[++i]);
+            string r;
+            while (getline(regbuf, r, ',')) {
+                if (!r.empty()) ctxregs.push_back(r);
+            }
+        }
+        else if (arg == "-g") {
+            cfgout = true;
+        }
+        else if (arg == "-l" && i + 1 < argc) {
+            loopout = true;
+            loopmin = atoi(argv[++i]);
+        }
+        else if (arg == "-f") {
+            funcout = true;
+        }
+        else if (arg == "-S" && i + 1 < argc) {
+            sigs.push_back(argv[++i]);
+        }
+        else if (arg == "-q" && i + 1 < argc) {
+            regionids.push_back(atoi(argv[++i]));
+        }
+        else if (arg == "-j" && i + 1 < argc) {
+            nwriters = atoi(argv[++i]);
+        }
+        else if (arg == "-H") {
+            htraceout = dispout = true;
+        }
+        else if (arg == "-b") {
+            vipout = dispout = true;
+        }
+        else if (arg == "-d") {
+            dispout = true;
+        }
+        else if (!tracefile && arg[0] != '-') {
+            tracefile = argv[i];
+        }
+        else {
+            tracefile = nullptr;
+            break;
+        }
+    }
+    if (!tracefile || ctxrunlen < 1 || loopmin < 1 || nwriters < 1 || ctxregs.empty() || ctxregs.size() > 64) {
+        cerr << "usage: " << argv[0] << " runs [-n <run length>] [tracefile]\n"
+             << "  report push/pop runs: longest, length histogram, operand sets (default instrace.txt)\n"
+             << "usage: " << argv[0] << " [-b] [-d] [-f] [-g] [-H] [-j <writers>] [-l <iterations>] [-n <run length>] [-q <trace id>]... [-R <reg,reg,...>] [-S <signature>]... <tracefile>\n"
+             << "  -b  recover the VIP, write (vip, opcode, handler) tuples to bytecode.txt (implies -d)\n"
+             << "  -d  rank indirect branch sites, write dispatcher targets to handlers.txt\n"
+             << "  -f  print the call tree's per-function instruction counts\n"
+             << "  -g  write the trace CFG to cfg.dot and cfg.simple.dot\n"
+             << "  -H  write the handler-level trace to handlers.trace (implies -d)\n"
+             << "  -j  threads writing the vmN.txt files (default 1)\n"
+             << "  -l  print loops, write loops.trace with loops of that many iterations folded\n"
+             << "  -n  pushes/pops in a context save/restore (default 7)\n"
+             << "  -q  print the VM regions containing that trace ID, innermost first\n"
+             << "  -R  registers they may use, at most 64 (default rax..r15)\n"
+             << "  -S  write where the signature matches to signatures.txt, e.g. pushfq,push*6\n"
+             << "      or movzx,jmp/r (*n repeats, /r /m /i: kind of first operand)\n";
         return 1;
     }
 
-    ifstream infile(argv[1]);
+    ifstream infile(tracefile);
     if (!infile.is_open()) {
-        cerr << "Open file error: " << argv[1] << endl;
+        cerr << "Open file error: " << tracefile << endl;
         return 1;
     }
 
@@ -640,21 +2387,57 @@ int main(int argc, char** argv)
     // Build opcode map, fill in numeric opcodes, build jump set
     preprocess(&instlist);
 
+    // The CFG needs the unmodified instruction stream
+    if (cfgout) {
+        CFG cfg(&instlist);
+        cfg.compressCFG();
+        cfg.checkConsist();
+        cfg.outputDot();
+        cfg.outputSimpleDot();
+    }
+
+    map<uint64_t, Func*>* funcmap = nullptr;
+    if (funcout) {
+        funcmap = buildFuncList(&instlist);
+    }
+
+    if (loopout) {
+        vector<LoopRun> loops = findloops(&instlist);
+        printloops(loops);
+        outputloopsummary(&instlist, loops, "loops.trace");
+        if (funcmap) countloops(funcmap, loops);
+    }
+
+    if (funcmap) {
+        printFuncmap(funcmap);
+    }
+
+    if (dispout) {
+        vector<uint64_t> entries;
+        uint64_t dispatcher = finddispatcher(&instlist, "handlers.txt", &entries);
+        if (vipout && dispatcher) {
+            findvip(&instlist, dispatcher, "bytecode.txt");
+        }
+        if (htraceout && dispatcher) {
+            outputhandlertrace(&instlist, dispatcher, entries, "handlers.trace");
+        }
+    }
+
     // Simple optimization pass
     peephole(&instlist);
 
-    // Extract sequences of 7 push/pop
+    if (!sigs.empty()) {
+        outputsigs(&instlist, sigs, "signatures.txt");
+    }
+
+    // Extract runs of ctxrunlen push/pop
     vmextract(&instlist);
 
     // Output them
-    outputvm(&ctxswh);
-
-    // If you want more CFG building, you can do it here
-    // e.g.,
-    // CFG cfg(&instlist);
-    // cfg.checkConsist();
-    // cfg.showCFG();
-    // cfg.outputDot();
+    RegionTree tree(&ctxswh);
+    outputvm(&ctxswh, tree, tracefile, nwriters);
+    outputregions(tree, "vmregions.txt");
+    printregionsat(tree, regionids);
 
     return 0;
 }